@@ -0,0 +1,205 @@
+/*
+	Laser Clock offline render benchmark.  Renders every time of day, 00:00:00 through 23:59:59,
+	for each combination of the given sizes, dividers and dwells, packs each frame into the DAC
+	wire format and hands it to a mock DAC, and reports per setting:
+		render ns	average time to build a frame, and the slowest frame
+		pack ns		average time to pack and send it to the (mock) DAC
+		points		average and largest number of points per frame
+		blanked		average number of blanked points per frame
+		fps		refresh rate the average and the largest frame allow at POINTS_PER_SECOND
+
+	No Helios DAC is needed; mockdac.cpp stands in for libHeliosDacAPI.
+
+	Build instructions:
+	g++ -O2 -Wall -DLASERCLOCK_BENCH -o laserbench bench.cpp mockdac.cpp laserclock.cpp glyphcache.cpp clockframe.cpp linekernel.cpp motion.cpp pathopt.cpp pointbudget.cpp renderthread.cpp compositor.cpp wireframe.cpp stats.cpp strokefont.cpp curves.cpp pointarena.cpp pointruns.cpp -lpthread
+
+	Example program execution:
+	./laserbench -sizes 150,250,350 -dividers 25,50,100 -dwells 5,10,20
+
+	The other drawing options of laserclock (-xpos, -ypos, -color, -hidden_dwell, -optimize_path,
+	-motion, -scan_speed, -scan_accel, -auto_budget, -target_fps) are accepted too.  -seconds n
+	renders only the first n seconds of the day, for a quicker run.
+*/
+
+#include "main.h"
+#include "clockframe.h"
+#include "pointbudget.h"
+#include "pathopt.h"
+#include "motion.h"
+#include "wireframe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SECONDS_PER_DAY	86400
+#define MAX_MATRIX	16	//values per list
+
+typedef struct
+{
+	int count;
+	float values[MAX_MATRIX];
+} ValueList;
+
+static void ParseList(const char* text, ValueList* list)
+{
+	list->count = 0;
+	while (*text && list->count < MAX_MATRIX) {
+		char* end;
+		float value = strtof(text, &end);
+		if (end == text) {
+			fprintf(stderr, "Bad list %s, use comma separated numbers..\n", text);
+			exit(1);
+		}
+		list->values[list->count++] = value;
+		text = (*end == ',') ? end + 1 : end;
+	}
+}
+
+static long long Nanoseconds()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static int BlankedPoints(const Frame* frame)
+{
+	int blanked = 0;
+
+	for (int i = 0; i < frame->num_points; i++) {
+		const HeliosDacClass::HeliosPoint* p = &frame->points[i];
+		if (p->r == 0 && p->g == 0 && p->b == 0)
+			blanked++;
+	}
+	return blanked;
+}
+
+// Renders the whole day at the current settings and prints one line of results.
+static void BenchSettings(HeliosDacClass& helios, int seconds)
+{
+	static ClockFrame clock;
+	static WireFrame wire;
+	int set_size = size;	//reported as given, -auto_budget may change divider and dwell
+	float set_divider = divider;
+	int set_dwell = dwell;
+	long long render_ns = 0, pack_ns = 0, max_ns = 0;
+	long long points = 0, blanked = 0;
+	int max_points = 0;
+
+	if (!InitClockFrame(&clock)) {
+		fprintf(stderr, "Out of memory for the frame..\n");
+		exit(1);
+	}
+
+	for (int s = 0; s < seconds; s++) {
+		struct tm tm;
+		memset(&tm, 0, sizeof(tm));
+		tm.tm_hour = s / 3600;
+		tm.tm_min = (s / 60) % 60;
+		tm.tm_sec = s % 60;
+
+		long long start = Nanoseconds();
+		BuildBudgetedClockFrame(&clock, &tm);
+		long long rendered = Nanoseconds();
+
+		BeginWireFrame(&wire);
+		PackWirePoints(&wire, clock.frame.points, clock.frame.num_points, 0, 0, clock.frame.brightness);
+		CommitWireFrame(&wire, clock.frame.pps);
+		SendWireFrame(helios, 0, &wire, 0);
+		long long packed = Nanoseconds();
+
+		render_ns += rendered - start;
+		pack_ns += packed - rendered;
+		if (rendered - start > max_ns)
+			max_ns = rendered - start;
+
+		points += clock.frame.num_points;
+		blanked += BlankedPoints(&clock.frame);
+		if (clock.frame.num_points > max_points)
+			max_points = clock.frame.num_points;
+	}
+
+	double avg_points = (double)points / seconds;
+	printf("%5d %7.1f %5d %10.0f %10lld %8.0f %7.1f %7d %7.1f %6.1f %6.1f\n",
+			set_size, set_divider, set_dwell,
+			(double)render_ns / seconds, max_ns, (double)pack_ns / seconds,
+			avg_points, max_points, (double)blanked / seconds,
+			avg_points > 0 ? POINTS_PER_SECOND / avg_points : 0.0,
+			max_points > 0 ? (double)POINTS_PER_SECOND / max_points : 0.0);
+	fflush(stdout);
+}
+
+int main(int argc, char ** argv)
+{
+	ValueList sizes = { 1, { (float)size } };
+	ValueList dividers = { 1, { divider } };
+	ValueList dwells = { 1, { (float)dwell } };
+	int seconds = SECONDS_PER_DAY;
+
+	for (int i = 1;i < argc;i++)
+	{
+		if (i + 1 >= argc)
+			break;
+		if (strcasecmp(argv[i],"-sizes") == 0)
+			ParseList(argv[i+1], &sizes);
+		if (strcasecmp(argv[i],"-dividers") == 0)
+			ParseList(argv[i+1], &dividers);
+		if (strcasecmp(argv[i],"-dwells") == 0)
+			ParseList(argv[i+1], &dwells);
+		if (strcasecmp(argv[i],"-seconds") == 0)
+			seconds = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-xpos") == 0)
+			xpos = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-ypos") == 0)
+			ypos = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-color") == 0)
+			color = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-hidden_dwell") == 0)
+			hidden_dwell = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-optimize_path") == 0)
+			optimize_path = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-motion") == 0)
+			motion = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-scan_speed") == 0)
+			scan_speed = atof(argv[i+1]);
+		if (strcasecmp(argv[i],"-scan_accel") == 0)
+			scan_accel = atof(argv[i+1]);
+		if (strcasecmp(argv[i],"-auto_budget") == 0)
+			auto_budget = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-target_fps") == 0)
+			target_fps = atoi(argv[i+1]);
+	}
+
+	if (seconds < 1 || seconds > SECONDS_PER_DAY)
+		seconds = SECONDS_PER_DAY;
+
+	HeliosDacClass helios;
+	if (helios.OpenDevices() < 1) {
+		fprintf(stderr, "Mock DAC failed to open..\n");
+		exit(1);
+	}
+
+	printf("%d frames per setting, %d points per second, optimize_path %d, motion %d, auto_budget %d\n",
+			seconds, POINTS_PER_SECOND, optimize_path, motion, auto_budget);
+	printf("%5s %7s %5s %10s %10s %8s %7s %7s %7s %6s %6s\n",
+			"size", "divider", "dwell", "render ns", "max ns", "pack ns",
+			"points", "max", "blanked", "fps", "min");
+
+	for (int s = 0; s < sizes.count; s++) {
+		for (int d = 0; d < dividers.count; d++) {
+			for (int w = 0; w < dwells.count; w++) {
+				// The budget controller starts over from each setting.
+				ResetPointBudget();
+				size = (int)sizes.values[s];
+				divider = dividers.values[d];
+				dwell = (int)dwells.values[w];
+				BenchSettings(helios, seconds);
+			}
+		}
+	}
+
+	helios.CloseDevices();
+	return 0;
+}
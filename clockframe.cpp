@@ -0,0 +1,156 @@
+//Clock frame layout, see clockframe.h
+
+#include "clockframe.h"
+#include "glyphcache.h"
+#include "motion.h"
+#include <stdio.h>
+#include <string.h>
+
+bool InitClockFrame(ClockFrame* clock)
+{
+	clock->valid = false;
+	return InitFrame(&clock->frame);
+}
+
+void InvalidateClockFrame(ClockFrame* clock)
+{
+	clock->valid = false;
+}
+
+static int SlotGlyph(int slot, const struct tm* tm)
+{
+	switch (slot) {
+		case 4: return tm->tm_hour/10;
+		case 5: return tm->tm_hour%10;
+		case 6: return tm->tm_min/10;
+		case 7: return tm->tm_min%10;
+		case 8: return tm->tm_sec/10;
+		case 9: return tm->tm_sec%10;
+		default: return GLYPH_COLON;
+	}
+}
+
+//Position of a slot, as passed to DrawCachedSquare for the colons and DrawCachedDigit for the digits.
+static void SlotPosition(int slot, int* x, int* y)
+{
+	switch (slot) {
+		case 0: *x = xpos + (int)(3.5 * size); *y = ypos - size/2; break;
+		case 1: *x = xpos + (int)(3.5 * size); *y = (ypos - size/2) - size; break;
+		case 2: *x = xpos + (int)(7.5 * size); *y = ypos - size/2; break;
+		case 3: *x = xpos + (int)(7.5 * size); *y = (ypos - size/2) - size; break;
+		default: *x = xpos + (slot - 4) * 2*size; *y = ypos; break;
+	}
+}
+
+static void DrawSlot(Frame* frame, int slot, int glyph)
+{
+	int x, y;
+
+	SlotPosition(slot, &x, &y);
+	if (glyph == GLYPH_COLON)
+		DrawCachedSquare(frame, x, y);
+	else
+		DrawCachedDigit(frame, glyph, x, y);
+}
+
+//Draws every slot in one pass, with the strokes reordered by the path optimizer.
+static void DrawOptimizedSlots(ClockFrame* clock)
+{
+	static StrokeList frame_strokes;
+	int x, y;
+
+	frame_strokes.num_strokes = 0;
+	for (int i = 0; i < NUM_SLOTS; i++) {
+		SlotPosition(i, &x, &y);
+		bool fits = (clock->slots[i].glyph == GLYPH_COLON) ?
+				AppendCachedSquareStrokes(&frame_strokes, x, y) :
+				AppendCachedDigitStrokes(&frame_strokes, clock->slots[i].glyph, x, y);
+		if (!fits)
+			fprintf(stderr, "Too many strokes in frame, some are not drawn..\n");
+	}
+
+	ClearFrame(&clock->frame);
+	DrawOptimizedPath(&clock->frame, &frame_strokes);
+}
+
+int BuildClockFrame(ClockFrame* clock, const struct tm* tm)
+{
+	Frame* frame = &clock->frame;
+	Slot* slots = clock->slots;
+	SlotLayout layout;
+
+	GlyphCacheUpdate();
+
+	layout.xpos = xpos;
+	layout.ypos = ypos;
+	layout.size = size;
+	layout.optimize_path = optimize_path;
+	layout.glyph_generation = GlyphCacheGeneration();
+
+	if (memcmp(&layout, &clock->layout, sizeof(layout)) != 0)
+		clock->valid = false;
+
+	int changed = 0;
+	if (clock->valid) {
+		while (changed < NUM_SLOTS && slots[changed].glyph == SlotGlyph(changed, tm))
+			changed++;
+	}
+
+	if (changed == NUM_SLOTS)
+		return 0;
+
+	if (optimize_path) {
+		// Strokes of different slots are interleaved, so the frame is rebuilt as a whole.
+		for (int i = 0; i < NUM_SLOTS; i++) {
+			slots[i].glyph = SlotGlyph(i, tm);
+			slots[i].first = 0;
+			slots[i].count = 0;
+		}
+		DrawOptimizedSlots(clock);
+		changed = 0;
+
+		// The tour ends where it starts.
+		clock->body_points = frame->num_points;
+		clock->start_x = clock->body_x = frame->x_start;
+		clock->start_y = clock->body_y = frame->y_start;
+	} else {
+		// Every slot after the first changed one shifts, so re-splice the whole tail.
+		int first_x, first_y;
+		SlotPosition(0, &first_x, &first_y);
+		CachedSquareStart(first_x, first_y, &first_x, &first_y);
+
+		if (changed > 0) {
+			TruncateFrame(frame, slots[changed - 1].first + slots[changed - 1].count);
+			frame->x_start = slots[changed - 1].end_x;
+			frame->y_start = slots[changed - 1].end_y;
+		} else {
+			// The frame repeats, so the pen is already where the first slot starts.
+			TruncateFrame(frame, 0);
+			frame->x_start = first_x;
+			frame->y_start = first_y;
+		}
+
+		for (int i = changed; i < NUM_SLOTS; i++) {
+			slots[i].glyph = SlotGlyph(i, tm);
+			slots[i].first = frame->num_points;
+			DrawSlot(frame, i, slots[i].glyph);
+			slots[i].end_x = frame->x_start;
+			slots[i].end_y = frame->y_start;
+			if (i == NUM_SLOTS - 1) {
+				clock->body_points = frame->num_points;
+				clock->body_x = frame->x_start;
+				clock->body_y = frame->y_start;
+			}
+			if (motion && i == NUM_SLOTS - 1)
+				DrawLineTo(frame, first_x, first_y, 0);
+			slots[i].count = frame->num_points - slots[i].first;
+		}
+		clock->start_x = motion ? first_x : -1;
+		clock->start_y = motion ? first_y : -1;
+	}
+
+	clock->layout = layout;
+	clock->valid = true;
+
+	return NUM_SLOTS - changed;
+}
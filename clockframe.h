@@ -0,0 +1,60 @@
+//Clock frame layout.  The frame is split into fixed slots, one per digit and colon square, each
+//holding its own run of points in the frame.  Slots are kept in order from least to most often
+//changing, so a new second only re-renders and re-splices the slots from the first changed one on.
+//With optimize_path set the strokes of all slots are interleaved and any change rebuilds the frame.
+//With -motion each slot starts with the blank jump from the previous slot's end, and the last slot
+//ends with the jump back to the first, so a slot only depends on the ones before it.
+
+#include "main.h"
+#include <time.h>
+
+#pragma once
+
+#define NUM_SLOTS	10	//4 colon squares, then HH MM SS
+
+typedef struct
+{
+	int glyph;	//digit 0-9 or GLYPH_COLON
+	int first;	//index of the slot's first point in the frame
+	int count;
+	int end_x;	//pen position after the slot
+	int end_y;
+} Slot;
+
+//Settings the slots were rendered with.  Any difference re-renders every slot.
+typedef struct
+{
+	int xpos;
+	int ypos;
+	int size;
+	int optimize_path;
+	int glyph_generation;
+} SlotLayout;
+
+//A clock frame and the slot bookkeeping needed to update it in place.
+typedef struct
+{
+	Frame frame;
+	Slot slots[NUM_SLOTS];
+	SlotLayout layout;
+	bool valid;
+
+	// Where the clock's own points end, before the closing jump that -motion adds, so more
+	// content can be drawn after them (see compositor.h).
+	int body_points;
+	int body_x;	//pen position there
+	int body_y;
+	int start_x;	//pen position the frame is drawn from, which it has to end at to repeat,
+	int start_y;	//-1 when it starts with a blank jump of its own
+} ClockFrame;
+
+//Gives the clock frame its point storage and marks it for a full render.  Returns false if out of memory.
+bool InitClockFrame(ClockFrame* clock);
+
+//Brings the frame up to date for the given time, reusing the point runs of every slot
+//before the first one whose value changed.
+//Returns the number of slots that were re-rendered.
+int BuildClockFrame(ClockFrame* clock, const struct tm* tm);
+
+//Forces the next BuildClockFrame to re-render every slot.
+void InvalidateClockFrame(ClockFrame* clock);
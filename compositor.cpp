@@ -0,0 +1,432 @@
+//Frame compositor, see compositor.h
+
+#include "compositor.h"
+#include "motion.h"
+#include "pathopt.h"
+#include "pointbudget.h"
+#include "strokefont.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char* temp_file = "/sys/class/thermal/thermal_zone0/temp";
+int temp_interval = 10;
+
+struct Zone;
+
+//What a zone shows and how often it is brought up to date.
+typedef struct
+{
+	const char* option;
+	void (*build)(struct Zone* zone, time_t t, char* text);	//fills in the text for time t
+	const int* interval;	//seconds
+	int priority;
+} ZoneKind;
+
+//Settings a zone was drawn with.  Any difference draws it again.
+typedef struct
+{
+	char text[MAX_ZONE_TEXT + 1];
+	int level;
+	int color;
+	float divider;
+	int dwell;
+	int hidden_dwell;
+	int motion;
+	float scan_speed;
+	float scan_accel;
+} ZoneKey;
+
+typedef struct Zone
+{
+	const ZoneKind* kind;
+	int x;
+	int y;
+	int size;
+	int max_points;
+	int priority;
+
+	char text[MAX_ZONE_TEXT + 1];
+	time_t next_update;
+
+	int level;	//steps coarser than the command line divider
+	Frame frame;	//the zone drawn in place, from its first vertex
+	ZoneKey key;
+	bool drawn;
+	bool fits;	//within max_points
+	int start_x;	//first vertex, with -motion the jump into the zone is drawn to here
+	int start_y;
+	int end_x;	//pen position after the zone
+	int end_y;
+	bool warned_read;
+	bool warned_size;
+} Zone;
+
+static void DateText(Zone* zone, time_t t, char* text);
+static void TempText(Zone* zone, time_t t, char* text);
+
+static const int every_second = 1;
+
+static const ZoneKind zone_kinds[] = {
+	{ "-date_zone", DateText, &every_second, DATE_ZONE_PRIORITY },	//ZONE_DATE
+	{ "-temp_zone", TempText, &temp_interval, TEMP_ZONE_PRIORITY },	//ZONE_TEMP
+};
+
+static Zone zones[MAX_ZONES];
+static int num_zones = 0;
+
+//Frames in a row composed within budget without a zone degraded.
+static int settled = 0;
+
+static void DateText(Zone* zone, time_t t, char* text)
+{
+	struct tm tm;
+
+	(void)zone;
+	localtime_r(&t, &tm);
+	strftime(text, MAX_ZONE_TEXT + 1, "%Y-%m-%d", &tm);
+}
+
+//Shows degrees to a tenth, or "--.-" while temp_file cannot be read.
+static void TempText(Zone* zone, time_t t, char* text)
+{
+	char buffer[128];
+
+	(void)t;
+	FILE* f = fopen(temp_file, "r");
+	size_t length = 0;
+	if (f != NULL) {
+		length = fread(buffer, 1, sizeof(buffer) - 1, f);
+		fclose(f);
+	}
+	buffer[length] = 0;
+
+	const char* value = strstr(buffer, "t=");
+	value = (value != NULL) ? value + 2 : buffer;
+	char* end;
+	long milli = strtol(value, &end, 10);
+	if (end == value) {
+		if (!zone->warned_read)
+			fprintf(stderr, "Could not read a temperature from %s..\n", temp_file);
+		zone->warned_read = true;
+		strcpy(text, "--.-");
+		return;
+	}
+	zone->warned_read = false;
+
+	long rounded = (milli >= 0 ? milli + 50 : milli - 50) / 100;
+	int tenths = (rounded > 99999) ? 99999 : (rounded < -99999) ? -99999 : (int)rounded;
+	snprintf(text, MAX_ZONE_TEXT + 1, "%s%d.%d", tenths < 0 ? "-" : "", abs(tenths) / 10, abs(tenths) % 10);
+}
+
+bool AddZone(int kind, const char* spec)
+{
+	const ZoneKind* zone_kind = &zone_kinds[kind];
+
+	if (num_zones >= MAX_ZONES) {
+		fprintf(stderr, "Only %d zones can be shown, %s %s is one too many..\n", MAX_ZONES, zone_kind->option, spec);
+		return false;
+	}
+
+	Zone* zone = &zones[num_zones];
+	memset(zone, 0, sizeof(*zone));
+	zone->kind = zone_kind;
+	zone->priority = zone_kind->priority;
+
+	int fields = sscanf(spec, "%d,%d,%d,%d,%d", &zone->x, &zone->y, &zone->size, &zone->max_points, &zone->priority);
+	if (fields < 3 || zone->size <= 0 || zone->max_points < 0) {
+		fprintf(stderr, "Bad %s %s, use x,y,size[,points[,priority]]..\n", zone_kind->option, spec);
+		return false;
+	}
+
+	num_zones++;
+	return true;
+}
+
+int NumZones()
+{
+	return num_zones;
+}
+
+void ClearZones()
+{
+	num_zones = 0;
+	settled = 0;
+}
+
+//Lays the text out in cells one and a half sizes apart from the zone's corner.
+static void DrawZoneText(Frame* frame, const Zone* zone)
+{
+	for (int i = 0; zone->text[i]; i++)
+		DrawChar(frame, zone->text[i], zone->x + i * (3 * zone->size / 2), zone->y, color, zone->size);
+}
+
+//Draws the zone's text at its level, unless it is drawn with the same settings already.
+static void DrawZone(Zone* zone)
+{
+	static StrokeList strokes;
+	Frame* frame = &zone->frame;
+	ZoneKey key;
+
+	// Zones are coarsened on their own, so they start from the command line settings rather
+	// than what the budget controller has the clock at, and coarsen the same way.
+	memset(&key, 0, sizeof(key));
+	memcpy(key.text, zone->text, sizeof(key.text));
+	key.level = zone->level;
+	key.color = color;
+	LevelSettings(zone->level, &key.divider, &key.dwell, &key.hidden_dwell);
+	key.motion = motion;
+	key.scan_speed = scan_speed;
+	key.scan_accel = scan_accel;
+
+	if (zone->drawn && memcmp(&key, &zone->key, sizeof(key)) == 0)
+		return;
+
+	zone->drawn = false;
+	if (!InitFrame(frame)) {
+		fprintf(stderr, "Out of memory for %s..\n", zone->kind->option);
+		return;
+	}
+
+	// The vertex geometry first, for where the text starts, as the glyph cache does.
+	strokes.num_strokes = 0;
+	strokes.pen_down = false;
+	frame->recorder = &strokes;
+	DrawZoneText(frame, zone);
+	frame->recorder = NULL;
+	zone->start_x = strokes.num_strokes ? strokes.strokes[0].x[0] : zone->x;
+	zone->start_y = strokes.num_strokes ? strokes.strokes[0].y[0] : zone->y;
+
+	ClearFrame(frame);
+	frame->x_start = zone->start_x;
+	frame->y_start = zone->start_y;
+
+	float clock_divider = divider;
+	int clock_dwell = dwell;
+	int clock_hidden_dwell = hidden_dwell;
+	divider = key.divider;
+	dwell = key.dwell;
+	hidden_dwell = key.hidden_dwell;
+	DrawZoneText(frame, zone);
+	divider = clock_divider;
+	dwell = clock_dwell;
+	hidden_dwell = clock_hidden_dwell;
+
+	zone->end_x = frame->x_start;
+	zone->end_y = frame->y_start;
+	zone->key = key;
+	zone->drawn = true;
+	zone->fits = zone->max_points == 0 || frame->num_points <= zone->max_points;
+}
+
+static bool ZoneShown(const Zone* zone)
+{
+	return zone->drawn && zone->fits;
+}
+
+static int ZonePoints()
+{
+	int points = 0;
+
+	for (int i = 0; i < num_zones; i++) {
+		if (ZoneShown(&zones[i]))
+			points += zones[i].frame.num_points;
+	}
+	return points;
+}
+
+//Brings the text of every zone that is due up to date, and draws the zones whose text changed
+//within their own point budgets.
+static void UpdateZones(time_t t)
+{
+	for (int i = 0; i < num_zones; i++) {
+		Zone* zone = &zones[i];
+		int interval = (*zone->kind->interval > 0) ? *zone->kind->interval : 1;
+
+		// Also when the clock was set back.
+		if (t >= zone->next_update || t < zone->next_update - interval) {
+			zone->kind->build(zone, t, zone->text);
+			zone->next_update = t + interval;
+		}
+
+		DrawZone(zone);
+		while (zone->drawn && !zone->fits && zone->level < MAX_ZONE_LEVEL) {
+			zone->level++;
+			DrawZone(zone);
+		}
+
+		if (zone->drawn && !zone->fits && !zone->warned_size) {
+			fprintf(stderr, "%s \"%s\" takes %d points, over its %d even at the coarsest settings, not drawn..\n",
+					zone->kind->option, zone->text, zone->frame.num_points, zone->max_points);
+		}
+		zone->warned_size = zone->drawn && !zone->fits;
+	}
+}
+
+//Tries every order of the zones in shown[from..n-1] after those before from, keeping the one
+//with the least blanked travel from (x,y) through the zones and back to (wrap_x,wrap_y).
+static void SearchOrder(int* shown, int n, int from, int x, int y, int length, int wrap_x, int wrap_y,
+		int* best, int* best_length)
+{
+	if (from == n) {
+		length += JumpLength(x, y, wrap_x, wrap_y);
+		if (*best_length < 0 || length < *best_length) {
+			memcpy(best, shown, n * sizeof(*best));
+			*best_length = length;
+		}
+		return;
+	}
+
+	for (int i = from; i < n; i++) {
+		int swap = shown[from];
+		shown[from] = shown[i];
+		shown[i] = swap;
+
+		const Zone* zone = &zones[shown[from]];
+		SearchOrder(shown, n, from + 1, zone->end_x, zone->end_y, length + JumpLength(x, y, zone->start_x, zone->start_y),
+				wrap_x, wrap_y, best, best_length);
+
+		shown[i] = shown[from];
+		shown[from] = swap;
+	}
+}
+
+//Draws the shown zones after the clock's own points, in the order with the least blanked
+//travel, and closes the frame back to where the clock starts.
+static void ComposeZones(ClockFrame* clock)
+{
+	Frame* frame = &clock->frame;
+	int shown[MAX_ZONES];
+	int order[MAX_ZONES];
+	int n = 0;
+
+	TruncateFrame(frame, clock->body_points);
+	frame->x_start = clock->body_x;
+	frame->y_start = clock->body_y;
+
+	for (int i = 0; i < num_zones; i++) {
+		if (ZoneShown(&zones[i]))
+			shown[n++] = i;
+	}
+
+	// Without a closing jump the DAC jumps from the last point straight to the first.
+	int wrap_x = clock->start_x;
+	int wrap_y = clock->start_y;
+	if (wrap_x < 0) {
+		wrap_x = (frame->num_points > 0) ? frame->points[0].x : frame->x_start;
+		wrap_y = (frame->num_points > 0) ? frame->points[0].y : frame->y_start;
+	}
+
+	int best_length = -1;
+	SearchOrder(shown, n, 0, frame->x_start, frame->y_start, 0, wrap_x, wrap_y, order, &best_length);
+
+	for (int i = 0; i < n; i++) {
+		const Zone* zone = &zones[order[i]];
+
+		// Without -motion the zone starts with a blank jump of its own, as a glyph does.
+		if (motion && (frame->x_start != zone->start_x || frame->y_start != zone->start_y))
+			DrawLineTo(frame, zone->start_x, zone->start_y, 0);
+
+		int count = FrameRoom(frame, zone->frame.num_points);
+		memcpy(&frame->points[frame->num_points], zone->frame.points, count * sizeof(*frame->points));
+		frame->num_points += count;
+		frame->x_start = zone->end_x;
+		frame->y_start = zone->end_y;
+	}
+
+	if (clock->start_x >= 0 && (frame->x_start != clock->start_x || frame->y_start != clock->start_y))
+		DrawLineTo(frame, clock->start_x, clock->start_y, 0);
+}
+
+//Draws the lowest priority zone that can still go coarser one level coarser.  Returns false if none can.
+static bool DegradeZone()
+{
+	Zone* zone = NULL;
+
+	for (int i = 0; i < num_zones; i++) {
+		if (ZoneShown(&zones[i]) && zones[i].level < MAX_ZONE_LEVEL && (zone == NULL || zones[i].priority < zone->priority))
+			zone = &zones[i];
+	}
+	if (zone == NULL)
+		return false;
+
+	zone->level++;
+	DrawZone(zone);
+	return true;
+}
+
+//Steps the highest priority coarsened zone back one level, if the frame still fits with it and
+//room to spare, so the clock's next digits do not push the zones straight back.
+static void RelaxZone(ClockFrame* clock, int budget)
+{
+	Zone* zone = NULL;
+
+	for (int i = 0; i < num_zones; i++) {
+		if (ZoneShown(&zones[i]) && zones[i].level > 0 && (zone == NULL || zones[i].priority > zone->priority))
+			zone = &zones[i];
+	}
+	if (zone == NULL || PointBudgetLevel() > 0)
+		return;
+
+	zone->level--;
+	DrawZone(zone);
+	ComposeZones(clock);
+	if (zone->drawn && zone->fits && FitsWithMargin(clock->frame.num_points, budget))
+		return;
+
+	zone->level++;
+	DrawZone(zone);
+	ComposeZones(clock);
+}
+
+int ComposeClockFrame(ClockFrame* clock, const struct tm* tm, time_t t)
+{
+	int points[MAX_ZONES];
+	float zone_divider;
+	int zone_dwell, zone_hidden_dwell;
+
+	if (num_zones == 0)
+		return BuildBudgetedClockFrame(clock, tm);
+
+	// Measured once the text is up to date, so only what the budget changes is reported.
+	UpdateZones(t);
+	for (int i = 0; i < num_zones; i++)
+		points[i] = ZoneShown(&zones[i]) ? zones[i].frame.num_points : -1;
+
+	// The clock is built, and measured by the budget controller, without the zones composed
+	// into the frame last time.
+	int budget = FrameBudget();
+	if (clock->valid)
+		TruncateFrame(&clock->frame, clock->body_points);
+	ReserveBudget(ZonePoints());
+	int rendered = BuildBudgetedClockFrame(clock, tm);
+	ComposeZones(clock);
+
+	// Zones give up detail before the clock does, lowest priority first.
+	bool degraded = false;
+	while ((clock->frame.num_points > budget || PointBudgetLevel() > 0) && DegradeZone()) {
+		degraded = true;
+		TruncateFrame(&clock->frame, clock->body_points);
+		ReserveBudget(ZonePoints());
+		int more = BuildBudgetedClockFrame(clock, tm);
+		rendered = (more > rendered) ? more : rendered;
+		ComposeZones(clock);
+	}
+	// As the clock does, zones step back only once the frame has fit for a while.
+	settled = (!degraded && clock->frame.num_points <= budget) ? settled + 1 : 0;
+	if (settled >= BUDGET_SETTLE_FRAMES) {
+		RelaxZone(clock, budget);
+		settled = 0;
+	}
+
+	for (int i = 0; i < num_zones; i++) {
+		if (points[i] >= 0 && ZoneShown(&zones[i]) && zones[i].frame.num_points != points[i]) {
+			LevelSettings(zones[i].level, &zone_divider, &zone_dwell, &zone_hidden_dwell);
+			fprintf(stderr, "Point budget %d: %s divider %.1f, dwell %d, hidden_dwell %d, %d points\n", budget,
+					zones[i].kind->option, zone_divider, zone_dwell, zone_hidden_dwell, zones[i].frame.num_points);
+		}
+	}
+
+	SetFrameRate(&clock->frame);
+	return rendered;
+}
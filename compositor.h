@@ -0,0 +1,57 @@
+//Frame compositor.  Besides the clock a frame can show zones of other content: the date with
+//-date_zone, and a temperature reading with -temp_zone.  Each zone has its own builder, which
+//makes the zone's text, an update interval, a point budget and a priority.  A zone is drawn
+//with the stroke font into a frame of its own and kept there, so a static zone costs one copy
+//per frame and only a zone whose text changed is drawn again.
+//
+//The zones follow the clock's own points in the frame, in whichever order makes the blanked
+//travel around the frame shortest.  When the frame is over FrameBudget() the lowest priority
+//zone is drawn coarser first, a step at a time, with the divider and dwell counts scaled as
+//-auto_budget scales the clock's (see LevelSettings), and the clock, which has the
+//highest priority, is only left to -auto_budget once every zone is as coarse as it goes.
+//Coarsened zones step back one at a time, highest priority first, once the frame has fit for
+//BUDGET_SETTLE_FRAMES in a row and still fits with BUDGET_MARGIN_PERCENT to spare.
+//
+//A zone is given as x,y,size[,points[,priority]]: its text starts with its bottom left corner
+//at (x,y), characters size wide and 2*size tall, as DrawChar places them.  points is the most
+//the zone may take, 0 for no limit of its own; a zone still over it at the coarsest settings is
+//not drawn.  Zones with a lower priority give up detail first.
+
+#include "main.h"
+#include "clockframe.h"
+#include <time.h>
+
+#pragma once
+
+#define MAX_ZONES		4
+#define MAX_ZONE_TEXT		16
+#define MAX_ZONE_LEVEL		12	//divider up to 4x coarser, dwell down to 1/4
+
+#define ZONE_DATE		0	//YYYY-MM-DD, checked every second
+#define ZONE_TEMP		1	//degrees C from temp_file, read every temp_interval seconds
+
+#define DATE_ZONE_PRIORITY	1
+#define TEMP_ZONE_PRIORITY	2
+
+//File the temperature zone reads, set with -temp_file.  It holds millidegrees C, as the
+//kernel's thermal zones do, or a 1-Wire sensor's w1_slave file after "t=".
+extern const char* temp_file;
+
+//Seconds between readings of temp_file, set with -temp_interval.
+extern int temp_interval;
+
+//Adds a zone of the given kind from its x,y,size[,points[,priority]] spec.  Returns false,
+//with a message, if the spec is bad or there are MAX_ZONES already.
+bool AddZone(int kind, const char* spec);
+
+//Returns the number of zones added.
+int NumZones();
+
+//Drops every zone, so frames hold only the clock.
+void ClearZones();
+
+//Builds the clock frame for tm, local time t, with BuildBudgetedClockFrame and draws the
+//zones after it, all within the point budget.  Without zones this is BuildBudgetedClockFrame.
+//The zones are not locked; only one thread may compose frames.
+//Returns the number of slots re-rendered.
+int ComposeClockFrame(ClockFrame* clock, const struct tm* tm, time_t t);
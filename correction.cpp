@@ -0,0 +1,385 @@
+//Geometric correction, see correction.h
+
+#include "correction.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(CORRECTION_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define CORRECTION_SSE2
+#elif !defined(CORRECTION_NO_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CORRECTION_NEON
+#endif
+
+// The vector paths load a point as one 64 bit word: x, y, then r, g, b, i.
+static_assert(sizeof(HeliosDacClass::HeliosPoint) == 8, "HeliosPoint layout changed");
+
+#define CENTER	2048.0f
+
+float pincushion = 0;
+const char* correction_grid = NULL;
+
+static float matrix[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+static bool has_matrix = false;
+
+static int grid_cols = 0;
+static int grid_rows = 0;
+static float grid_dx[MAX_GRID * MAX_GRID];
+static float grid_dy[MAX_GRID * MAX_GRID];
+
+//Reads count comma separated numbers.  Returns false unless there are exactly that many.
+static bool ParseValues(const char* text, double* values, int count)
+{
+	for (int i = 0; i < count; i++) {
+		char* end;
+		values[i] = strtod(text, &end);
+		if (end == text || (i < count - 1 && *end != ','))
+			return false;
+		text = end + (i < count - 1);
+	}
+	return *text == 0;
+}
+
+bool SetHomography(const char* text)
+{
+	double values[9];
+
+	if (!ParseValues(text, values, 9)) {
+		fprintf(stderr, "Bad -homography %s, use 9 comma separated numbers..\n", text);
+		return false;
+	}
+	for (int i = 0; i < 9; i++)
+		matrix[i] = values[i];
+	has_matrix = true;
+	return true;
+}
+
+//Solves the n by n system a x = b in place, b becoming x.  Returns false if it is singular.
+static bool Solve(double a[8][8], double* b, int n)
+{
+	for (int col = 0; col < n; col++) {
+		int pivot = col;
+		for (int row = col + 1; row < n; row++) {
+			if (fabs(a[row][col]) > fabs(a[pivot][col]))
+				pivot = row;
+		}
+		if (fabs(a[pivot][col]) < 1e-12)
+			return false;
+
+		for (int k = 0; k < n; k++) {
+			double swap = a[col][k];
+			a[col][k] = a[pivot][k];
+			a[pivot][k] = swap;
+		}
+		double swap = b[col];
+		b[col] = b[pivot];
+		b[pivot] = swap;
+
+		for (int row = 0; row < n; row++) {
+			if (row == col)
+				continue;
+			double f = a[row][col] / a[col][col];
+			for (int k = col; k < n; k++)
+				a[row][k] -= f * a[col][k];
+			b[row] -= f * b[col];
+		}
+	}
+
+	for (int i = 0; i < n; i++)
+		b[i] /= a[i][i];
+	return true;
+}
+
+bool SetCorners(const char* text)
+{
+	static const double from[4][2] = { { 0, 0 }, { 4095, 0 }, { 4095, 4095 }, { 0, 4095 } };
+	double to[8];
+	double a[8][8];
+	double h[8];
+
+	if (!ParseValues(text, to, 8)) {
+		fprintf(stderr, "Bad -corners %s, use 8 comma separated numbers..\n", text);
+		return false;
+	}
+
+	// Each corner gives two equations in h11..h32, with h33 = 1.
+	memset(a, 0, sizeof(a));
+	for (int i = 0; i < 4; i++) {
+		double x = from[i][0], y = from[i][1];
+		double u = to[2*i], v = to[2*i + 1];
+		double* ru = a[2*i];
+		double* rv = a[2*i + 1];
+
+		ru[0] = x; ru[1] = y; ru[2] = 1; ru[6] = -x * u; ru[7] = -y * u;
+		rv[3] = x; rv[4] = y; rv[5] = 1; rv[6] = -x * v; rv[7] = -y * v;
+		h[2*i] = u;
+		h[2*i + 1] = v;
+	}
+
+	if (!Solve(a, h, 8)) {
+		fprintf(stderr, "-corners %s leave no picture, three of them are in line..\n", text);
+		return false;
+	}
+	for (int i = 0; i < 8; i++)
+		matrix[i] = h[i];
+	matrix[8] = 1;
+	has_matrix = true;
+	return true;
+}
+
+bool LoadCorrectionGrid()
+{
+	FILE* f = fopen(correction_grid, "r");
+	if (f == NULL) {
+		fprintf(stderr, "Could not open correction grid %s..\n", correction_grid);
+		return false;
+	}
+
+	int cols, rows;
+	bool ok = fscanf(f, "%d %d", &cols, &rows) == 2 && cols >= 2 && cols <= MAX_GRID && rows >= 2 && rows <= MAX_GRID;
+	for (int i = 0; ok && i < cols * rows; i++)
+		ok = fscanf(f, "%f %f", &grid_dx[i], &grid_dy[i]) == 2;
+	fclose(f);
+
+	if (!ok) {
+		fprintf(stderr, "Bad correction grid %s, it needs columns and rows, 2 to %d each, then an x and y offset per node..\n",
+				correction_grid, MAX_GRID);
+		grid_cols = grid_rows = 0;
+		return false;
+	}
+	grid_cols = cols;
+	grid_rows = rows;
+	return true;
+}
+
+bool CorrectionEnabled()
+{
+	return has_matrix || pincushion != 0 || grid_cols > 0;
+}
+
+//Adds the grid's offset at (x,y), interpolated between the four nodes around it.
+static void GridOffset(float* x, float* y)
+{
+	float gx = *x * (grid_cols - 1) / 4095.0f;
+	float gy = *y * (grid_rows - 1) / 4095.0f;
+
+	gx = (gx < 0) ? 0 : (gx > grid_cols - 1) ? grid_cols - 1 : gx;
+	gy = (gy < 0) ? 0 : (gy > grid_rows - 1) ? grid_rows - 1 : gy;
+
+	int c = (gx < grid_cols - 1) ? (int)gx : grid_cols - 2;
+	int r = (gy < grid_rows - 1) ? (int)gy : grid_rows - 2;
+	float fx = gx - c;
+	float fy = gy - r;
+
+	int n = r * grid_cols + c;
+	float w00 = (1 - fx) * (1 - fy), w10 = fx * (1 - fy), w01 = (1 - fx) * fy, w11 = fx * fy;
+
+	*x += w00 * grid_dx[n] + w10 * grid_dx[n + 1] + w01 * grid_dx[n + grid_cols] + w11 * grid_dx[n + grid_cols + 1];
+	*y += w00 * grid_dy[n] + w10 * grid_dy[n + 1] + w01 * grid_dy[n + grid_cols] + w11 * grid_dy[n + grid_cols + 1];
+}
+
+static void CorrectPoint(float* x, float* y)
+{
+	float u = matrix[0] * *x + matrix[1] * *y + matrix[2];
+	float v = matrix[3] * *x + matrix[4] * *y + matrix[5];
+	float w = matrix[6] * *x + matrix[7] * *y + matrix[8];
+
+	*x = u / w;
+	*y = v / w;
+
+	if (pincushion != 0) {
+		float cx = (*x - CENTER) / CENTER;
+		float cy = (*y - CENTER) / CENTER;
+		float s = 1 - pincushion * (cx * cx + cy * cy);
+		*x = CENTER + (*x - CENTER) * s;
+		*y = CENTER + (*y - CENTER) * s;
+	}
+
+	if (grid_cols > 0)
+		GridOffset(x, y);
+}
+
+//Rounds to the nearest DAC unit within 0..4095, anything not a number going to 0.
+static inline int ClampRound(float v)
+{
+	if (!(v > 0)) return 0;
+	if (v > 4095) return 4095;
+	return (int)lrintf(v);
+}
+
+#if defined(CORRECTION_SSE2) || defined(CORRECTION_NEON)
+//The grid is a lookup per point, so the vector paths hand their lanes to it one at a time.
+static void GridLanes(float* x, float* y)
+{
+	for (int lane = 0; lane < 4; lane++)
+		GridOffset(&x[lane], &y[lane]);
+}
+#endif
+
+void CorrectPoints(HeliosDacClass::HeliosPoint* out, const HeliosDacClass::HeliosPoint* in, int count, int dx, int dy)
+{
+	int i = 0;
+
+#if defined(CORRECTION_SSE2)
+	const __m128 h11 = _mm_set1_ps(matrix[0]), h12 = _mm_set1_ps(matrix[1]), h13 = _mm_set1_ps(matrix[2]);
+	const __m128 h21 = _mm_set1_ps(matrix[3]), h22 = _mm_set1_ps(matrix[4]), h23 = _mm_set1_ps(matrix[5]);
+	const __m128 h31 = _mm_set1_ps(matrix[6]), h32 = _mm_set1_ps(matrix[7]), h33 = _mm_set1_ps(matrix[8]);
+	const __m128 vdx = _mm_set1_ps((float)dx);
+	const __m128 vdy = _mm_set1_ps((float)dy);
+	const __m128 vcenter = _mm_set1_ps(CENTER);
+	const __m128 vscale = _mm_set1_ps(1 / CENTER);
+	const __m128 vk = _mm_set1_ps(pincushion);
+	const __m128 vone = _mm_set1_ps(1);
+	const __m128i vlow = _mm_set1_epi32(0xFFFF);
+	const __m128 vmin = _mm_setzero_ps();
+	const __m128 vmax = _mm_set1_ps(4095);
+
+	for (; i + 4 <= count; i += 4) {
+		// x | y << 16 of each point in one vector, its colors in another.
+		__m128i p01 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&in[i]), _MM_SHUFFLE(3, 1, 2, 0));
+		__m128i p23 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&in[i + 2]), _MM_SHUFFLE(3, 1, 2, 0));
+		__m128i xy = _mm_unpacklo_epi64(p01, p23);
+		__m128i colors = _mm_unpackhi_epi64(p01, p23);
+
+		__m128 x = _mm_add_ps(_mm_cvtepi32_ps(_mm_and_si128(xy, vlow)), vdx);
+		__m128 y = _mm_add_ps(_mm_cvtepi32_ps(_mm_srli_epi32(xy, 16)), vdy);
+
+		__m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h11, x), _mm_mul_ps(h12, y)), h13);
+		__m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h21, x), _mm_mul_ps(h22, y)), h23);
+		__m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h31, x), _mm_mul_ps(h32, y)), h33);
+		x = _mm_div_ps(u, w);
+		y = _mm_div_ps(v, w);
+
+		if (pincushion != 0) {
+			__m128 cx = _mm_sub_ps(x, vcenter);
+			__m128 cy = _mm_sub_ps(y, vcenter);
+			__m128 nx = _mm_mul_ps(cx, vscale);
+			__m128 ny = _mm_mul_ps(cy, vscale);
+			__m128 s = _mm_sub_ps(vone, _mm_mul_ps(vk, _mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny))));
+			x = _mm_add_ps(vcenter, _mm_mul_ps(cx, s));
+			y = _mm_add_ps(vcenter, _mm_mul_ps(cy, s));
+		}
+
+		if (grid_cols > 0) {
+			float lx[4], ly[4];
+			_mm_storeu_ps(lx, x);
+			_mm_storeu_ps(ly, y);
+			GridLanes(lx, ly);
+			x = _mm_loadu_ps(lx);
+			y = _mm_loadu_ps(ly);
+		}
+
+		// Rounded to nearest; out of range, and not a number, saturate and are clamped.
+		// Clamped before converting, as ClampRound does: out of range floats, infinities where w
+		// nears 0 among them, would convert to 0x80000000.  max gives its second operand for a
+		// NaN, so that goes to 0 too.
+		x = _mm_min_ps(_mm_max_ps(x, vmin), vmax);
+		y = _mm_min_ps(_mm_max_ps(y, vmin), vmax);
+		__m128i px = _mm_cvtps_epi32(x);
+		__m128i py = _mm_cvtps_epi32(y);
+		px = _mm_packs_epi32(px, px);
+		py = _mm_packs_epi32(py, py);
+
+		__m128i pxy = _mm_unpacklo_epi16(px, py);
+		_mm_storeu_si128((__m128i*)&out[i], _mm_unpacklo_epi32(pxy, colors));
+		_mm_storeu_si128((__m128i*)&out[i + 2], _mm_unpackhi_epi32(pxy, colors));
+	}
+#elif defined(CORRECTION_NEON)
+	const float32x4_t h11 = vdupq_n_f32(matrix[0]), h12 = vdupq_n_f32(matrix[1]), h13 = vdupq_n_f32(matrix[2]);
+	const float32x4_t h21 = vdupq_n_f32(matrix[3]), h22 = vdupq_n_f32(matrix[4]), h23 = vdupq_n_f32(matrix[5]);
+	const float32x4_t h31 = vdupq_n_f32(matrix[6]), h32 = vdupq_n_f32(matrix[7]), h33 = vdupq_n_f32(matrix[8]);
+	const float32x4_t vdx = vdupq_n_f32((float)dx);
+	const float32x4_t vdy = vdupq_n_f32((float)dy);
+	const float32x4_t vcenter = vdupq_n_f32(CENTER);
+	const float32x4_t vscale = vdupq_n_f32(1 / CENTER);
+	const float32x4_t vk = vdupq_n_f32(pincushion);
+	const float32x4_t vone = vdupq_n_f32(1);
+	const uint32x4_t vlow = vdupq_n_u32(0xFFFF);
+	const float32x4_t vmin = vdupq_n_f32(0);
+	const float32x4_t vmax = vdupq_n_f32(4095);
+
+	for (; i + 4 <= count; i += 4) {
+		// val[0] is x | y << 16 of each point, val[1] its colors.
+		uint32x4x2_t p = vld2q_u32((const uint32_t*)&in[i]);
+
+		float32x4_t x = vaddq_f32(vcvtq_f32_u32(vandq_u32(p.val[0], vlow)), vdx);
+		float32x4_t y = vaddq_f32(vcvtq_f32_u32(vshrq_n_u32(p.val[0], 16)), vdy);
+
+		float32x4_t u = vmlaq_f32(vmlaq_f32(h13, h11, x), h12, y);
+		float32x4_t v = vmlaq_f32(vmlaq_f32(h23, h21, x), h22, y);
+		float32x4_t w = vmlaq_f32(vmlaq_f32(h33, h31, x), h32, y);
+#if defined(__aarch64__)
+		x = vdivq_f32(u, w);
+		y = vdivq_f32(v, w);
+#else
+		// ARMv7 has no vector divide; two Newton steps on the estimate give full float precision.
+		float32x4_t r = vrecpeq_f32(w);
+		r = vmulq_f32(vrecpsq_f32(w, r), r);
+		r = vmulq_f32(vrecpsq_f32(w, r), r);
+		x = vmulq_f32(u, r);
+		y = vmulq_f32(v, r);
+#endif
+
+		if (pincushion != 0) {
+			float32x4_t cx = vsubq_f32(x, vcenter);
+			float32x4_t cy = vsubq_f32(y, vcenter);
+			float32x4_t nx = vmulq_f32(cx, vscale);
+			float32x4_t ny = vmulq_f32(cy, vscale);
+			float32x4_t s = vmlsq_f32(vone, vk, vmlaq_f32(vmulq_f32(nx, nx), ny, ny));
+			x = vmlaq_f32(vcenter, cx, s);
+			y = vmlaq_f32(vcenter, cy, s);
+		}
+
+		if (grid_cols > 0) {
+			float lx[4], ly[4];
+			vst1q_f32(lx, x);
+			vst1q_f32(ly, y);
+			GridLanes(lx, ly);
+			x = vld1q_f32(lx);
+			y = vld1q_f32(ly);
+		}
+
+		// Clamped before converting, as ClampRound does, so infinities where w nears 0 land at
+		// the same edge as in the scalar tail.  The compare is false for a NaN, which goes to 0.
+		x = vminq_f32(vbslq_f32(vcgtq_f32(x, vmin), x, vmin), vmax);
+		y = vminq_f32(vbslq_f32(vcgtq_f32(y, vmin), y, vmin), vmax);
+#if defined(__aarch64__)
+		int32x4_t px = vcvtnq_s32_f32(x);
+		int32x4_t py = vcvtnq_s32_f32(y);
+#else
+		// Conversion truncates, so the half unit added rounds the clamped value to nearest.
+		int32x4_t px = vcvtq_s32_f32(vaddq_f32(x, vdupq_n_f32(0.5f)));
+		int32x4_t py = vcvtq_s32_f32(vaddq_f32(y, vdupq_n_f32(0.5f)));
+#endif
+
+		p.val[0] = vorrq_u32(vreinterpretq_u32_s32(px), vshlq_n_u32(vreinterpretq_u32_s32(py), 16));
+		vst2q_u32((uint32_t*)&out[i], p);
+	}
+#endif
+
+	for (; i < count; i++) {
+		float x = in[i].x + dx;
+		float y = in[i].y + dy;
+
+		CorrectPoint(&x, &y);
+		out[i] = in[i];
+		out[i].x = ClampRound(x);
+		out[i].y = ClampRound(y);
+	}
+}
+
+void CorrectRuns(PointRun* out, const PointRun* in, int num_runs, int dx, int dy)
+{
+	for (int i = 0; i < num_runs; i++) {
+		float x = in[i].point.x + dx;
+		float y = in[i].point.y + dy;
+
+		CorrectPoint(&x, &y);
+		out[i] = in[i];
+		out[i].point.x = ClampRound(x);
+		out[i].point.y = ClampRound(y);
+	}
+}
@@ -0,0 +1,55 @@
+//Geometric correction.  Positioning with -xpos, -ypos and -size cannot undo what the projector
+//does to the picture: keystone from projecting at an angle, pincushion or barrel from the galvo
+//geometry and the optics, and whatever other bends a particular scanner has.  These are corrected
+//on the points as they are packed for each DAC, after its -dac_offset, in one pass that is four
+//points at a time with SSE2 or NEON:
+//
+//	-homography h11,h12,...,h33	a 3x3 matrix, row by row, taking (x,y,1) to (x',y',w'); the
+//					point drawn is (x'/w',y'/w').  Covers affine and keystone.
+//	-corners x0,y0,x1,y1,x2,y2,x3,y3	the same from where the corners (0,0), (4095,0),
+//					(4095,4095) and (0,4095) should land
+//	-pincushion k			after the matrix, scales each point away from the center by
+//					1 - k*r^2, r being 1 at 2048 units out; k > 0 pulls the edges in
+//	-correction_grid file		last, offsets looked up bilinearly from a grid measured on
+//					the projector
+//
+//The grid file holds the number of columns and rows, 2 to MAX_GRID each, then an x and a y
+//offset in DAC units for every node, a row at a time from y = 0 up.  The nodes are spread evenly
+//over 0..4095 in both directions.
+//
+//Straight lines stay straight through the matrix, so the divider only has to be fine enough
+//for the galvos to follow, not to bend lines back into shape.  Frames written to sinks are left
+//as drawn, since they are not played on this projector.
+//Define CORRECTION_NO_SIMD to build only the scalar path, e.g. to compare against it.
+
+#include "main.h"
+#include "pointruns.h"
+
+#pragma once
+
+#define MAX_GRID	33
+
+//Strength of the radial correction, set with -pincushion.  0 for none.
+extern float pincushion;
+
+//Grid file to load, set with -correction_grid.  NULL for none.
+extern const char* correction_grid;
+
+//Sets the matrix from the 9 comma separated values of -homography.  Returns false, with a message, if they are bad.
+bool SetHomography(const char* text);
+
+//Sets the matrix that moves the four corners to the 8 comma separated values of -corners.
+//Returns false, with a message, if they are bad or leave no picture.
+bool SetCorners(const char* text);
+
+//Loads correction_grid.  Returns false, with a message, if it cannot be read.
+bool LoadCorrectionGrid();
+
+//Returns true if any correction is set, false if points go out as drawn.
+bool CorrectionEnabled();
+
+//Writes the count points offset by (dx,dy) and corrected, clamped to the DAC range, to out.
+void CorrectPoints(HeliosDacClass::HeliosPoint* out, const HeliosDacClass::HeliosPoint* in, int count, int dx, int dy);
+
+//As CorrectPoints for the point of each run.
+void CorrectRuns(PointRun* out, const PointRun* in, int num_runs, int dx, int dy);
@@ -0,0 +1,275 @@
+//Curve primitives, see curves.h
+
+#include "curves.h"
+#include "linekernel.h"
+#include "motion.h"
+#include "pathopt.h"
+#include <math.h>
+
+#define SINE_TABLE_SIZE	1024	//entries per turn, a power of two
+#define MAX_CURVE_STEPS	10000	//a Bézier gives up after this many steps, however short
+
+#define PI_F	3.14159265f
+
+//One turn of sine, with the first entry repeated at the end so neighbours can be interpolated
+//without wrapping.  Linear interpolation between entries is good to about 5 millionths of the
+//radius, well under a DAC unit for any circle that fits on screen.
+static struct SineTable
+{
+	float value[SINE_TABLE_SIZE + 1];
+
+	SineTable()
+	{
+		for (int i = 0; i <= SINE_TABLE_SIZE; i++)
+			value[i] = (float)sin(2 * M_PI * i / SINE_TABLE_SIZE);
+	}
+} sine;
+
+//Sine and cosine of an angle in turns.
+static inline void SinCos(float turns, float* s, float* c)
+{
+	float f = (turns - floorf(turns)) * SINE_TABLE_SIZE;
+	int i = (int)f;
+
+	f -= i;
+	i &= SINE_TABLE_SIZE - 1;
+	int j = (i + SINE_TABLE_SIZE / 4) & (SINE_TABLE_SIZE - 1);
+
+	*s = sine.value[i] + (sine.value[i + 1] - sine.value[i]) * f;
+	*c = sine.value[j] + (sine.value[j + 1] - sine.value[j]) * f;
+}
+
+//Distance to the next point, at a place on the curve with the given radius of curvature.
+static float CurveStep(float radius, float done, float left)
+{
+	float step = motion ? MotionCurveStep(radius, done, left) : divider;
+
+	// A chord of length l strays l*l/(8*radius) from the arc it cuts off.
+	float chord = sqrtf(8 * CURVE_TOLERANCE * radius);
+	if (chord < step)
+		step = chord;
+	return (step < 1.0f) ? 1.0f : step;
+}
+
+//Returns false, with the frame marked overflowed, if it is full.
+static inline bool AddPoint(Frame* frame, const HeliosDacClass::HeliosPoint* proto, float x, float y)
+{
+	if (FrameRoom(frame, 1) == 0)
+		return false;
+
+	int ix = (int)lrintf(x);
+	int iy = (int)lrintf(y);
+	HeliosDacClass::HeliosPoint* point = &frame->points[frame->num_points++];
+
+	*point = *proto;
+	point->x = (ix < 0) ? 0 : (ix > 4095) ? 4095 : ix;
+	point->y = (iy < 0) ? 0 : (iy > 4095) ? 4095 : iy;
+	return true;
+}
+
+//Starts a visible curve at the pen position heading along (ux,uy).  With -motion a line that
+//ended here gives back what the turn into the curve does not need of its dwell, as in DrawLineTo.
+static void StartCurve(Frame* frame, float ux, float uy)
+{
+	if (motion && frame->tail_end == frame->num_points && frame->tail_dwell > 0) {
+		int keep = MotionCornerDwell(frame->tail_dx, frame->tail_dy, ux, uy);
+		if (keep < frame->tail_dwell)
+			frame->num_points -= frame->tail_dwell - keep;
+	}
+}
+
+//Dwells at (x,y), where a curve ended heading along (ux,uy), and leaves the pen there.
+static int EndCurve(Frame* frame, const HeliosDacClass::HeliosPoint* proto, int x, int y, float ux, float uy)
+{
+	HeliosDacClass::HeliosPoint point = *proto;
+	int count = FrameRoom(frame, dwell);
+
+	point.x = (x < 0) ? 0 : (x > 4095) ? 4095 : x;
+	point.y = (y < 0) ? 0 : (y > 4095) ? 4095 : y;
+	frame->num_points += FillPoints(&frame->points[frame->num_points], &point, count);
+
+	frame->tail_dx = ux;
+	frame->tail_dy = uy;
+	frame->tail_dwell = count;
+	frame->tail_end = frame->num_points;
+	frame->x_start = x;
+	frame->y_start = y;
+
+	return frame->num_points - 1;
+}
+
+//With a recorder set only the pen moves, and the next line starts a new stroke.
+static int RecordCurve(Frame* frame, int x, int y)
+{
+	StrokeRecorderLineTo(frame->recorder, frame->x_start, frame->y_start, x, y, 0);
+	frame->x_start = x;
+	frame->y_start = y;
+	return frame->num_points - 1;
+}
+
+int DrawArcSteps(Frame* frame, int x, int y, int color, float radius, float start, float sweep, float max_angle)
+{
+	float r = fabsf(radius);
+	float s, c;
+
+	// Angles are kept in turns from here on, the unit the sine table is indexed in.
+	float turn0 = start / 360;
+	float turns = sweep / 360;
+	float sign = (turns < 0) ? -1.0f : 1.0f;
+
+	SinCos(turn0, &s, &c);
+	int x0 = x + (int)lrintf(r * c);
+	int y0 = y + (int)lrintf(r * s);
+	SinCos(turn0 + turns, &s, &c);
+	int x1 = x + (int)lrintf(r * c);
+	int y1 = y + (int)lrintf(r * s);
+
+	if (frame->x_start != x0 || frame->y_start != y0)
+		DrawLineTo(frame, x0, y0, 0);
+
+	if (frame->recorder)
+		return RecordCurve(frame, x1, y1);
+
+	NoteClipping(x + r > 4095, y + r > 4095);
+
+	HeliosDacClass::HeliosPoint point = PalettePoint(color);
+	float length = 2 * PI_F * r * fabsf(turns);
+	float max_step = (max_angle > 0) ? 2 * PI_F * r * max_angle / 360 : length;
+
+	// The tangent is the radius turned a quarter turn in the direction of travel.
+	SinCos(turn0, &s, &c);
+	StartCurve(frame, -s * sign, c * sign);
+
+	// Without -motion the step is the same all the way round, so it is evened out to end on the end.
+	float even = 0;
+	if (!motion && length > 0) {
+		float step = CurveStep(r, 0, length);
+		if (step > max_step)
+			step = max_step;
+		even = length / ceilf(length / step);
+	}
+
+	float done = 0;
+	while (done < length) {
+		float step = motion ? CurveStep(r, done, length - done) : even;
+		if (step > max_step)
+			step = max_step;
+
+		done += step;
+		if (done >= length - 0.01f) {
+			AddPoint(frame, &point, x1, y1);
+			break;
+		}
+		SinCos(turn0 + sign * done / (2 * PI_F * r), &s, &c);
+		if (!AddPoint(frame, &point, x + r * c, y + r * s))
+			break;
+	}
+
+	SinCos(turn0 + turns, &s, &c);
+	return EndCurve(frame, &point, x1, y1, -s * sign, c * sign);
+}
+
+int DrawArc(Frame* frame, int x, int y, int color, float radius, float start, float sweep)
+{
+	return DrawArcSteps(frame, x, y, color, radius, start, sweep, 0);
+}
+
+int DrawCubicTo(Frame* frame, int cx1, int cy1, int cx2, int cy2, int x, int y, int color)
+{
+	float x0 = frame->x_start;
+	float y0 = frame->y_start;
+
+	if (frame->recorder)
+		return RecordCurve(frame, x, y);
+
+	NoteClipping(cx1 > 4095 || cx2 > 4095 || x > 4095 || x0 > 4095, cy1 > 4095 || cy2 > 4095 || y > 4095 || y0 > 4095);
+
+	// Power basis: B(t) = ((a*t + b)*t + c)*t + p0.
+	float ax = x - x0 + 3 * (cx1 - cx2);
+	float ay = y - y0 + 3 * (cy1 - cy2);
+	float bx = 3 * (x0 - 2 * cx1 + cx2);
+	float by = 3 * (y0 - 2 * cy1 + cy2);
+	float cx = 3 * (cx1 - x0);
+	float cy = 3 * (cy1 - y0);
+
+	// The curve is no longer than its control polygon and no shorter than its chord.
+	float chord = hypotf(x - x0, y - y0);
+	float polygon = hypotf(cx1 - x0, cy1 - y0) + hypotf(cx2 - cx1, cy2 - cy1) + hypotf(x - cx2, y - cy2);
+	float length = (chord + polygon) / 2;
+
+	HeliosDacClass::HeliosPoint point = PalettePoint(color);
+
+	// Nowhere to go, so only the dwell.
+	if (polygon == 0)
+		return EndCurve(frame, &point, x, y, 0, 0);
+
+	float t = 0, px = x0, py = y0, done = 0;
+	float dx = cx, dy = cy;
+
+	// A control point on an end leaves no tangent there; the curve sets off towards the next one.
+	if (dx == 0 && dy == 0) { dx = cx2 - x0; dy = cy2 - y0; }
+	if (dx == 0 && dy == 0) { dx = x - x0; dy = y - y0; }
+	float d = hypotf(dx, dy);
+	StartCurve(frame, dx / d, dy / d);
+
+	for (int n = 0; n < MAX_CURVE_STEPS; n++) {
+		// First and second derivatives give the speed along t and the radius of curvature.
+		float d1x = (3 * ax * t + 2 * bx) * t + cx;
+		float d1y = (3 * ay * t + 2 * by) * t + cy;
+		float d2x = 6 * ax * t + 2 * bx;
+		float d2y = 6 * ay * t + 2 * by;
+		float speed = hypotf(d1x, d1y);
+		float cross = fabsf(d1x * d2y - d1y * d2x);
+		float radius = (cross > 0) ? speed * speed * speed / cross : INFINITY;
+
+		float left = length - done;
+		float to_end = hypotf(x - px, y - py);
+		if (left < to_end)
+			left = to_end;
+
+		float step = CurveStep(radius, done, left);
+		float dt = (speed > step) ? step / speed : 1.0f / 64;
+
+		// The step in t is a first order guess; shorten it where the curve bends faster than that.
+		float nx, ny;
+		for (int tries = 0;; tries++) {
+			float nt = t + dt;
+			if (nt > 1)
+				nt = 1;
+			nx = ((ax * nt + bx) * nt + cx) * nt + x0;
+			ny = ((ay * nt + by) * nt + cy) * nt + y0;
+			if (tries == 4 || hypotf(nx - px, ny - py) <= 1.25f * step)
+				break;
+			dt /= 2;
+		}
+
+		t += dt;
+		if (t >= 1 - 1e-6f) {
+			AddPoint(frame, &point, x, y);
+			break;
+		}
+		done += hypotf(nx - px, ny - py);
+		px = nx;
+		py = ny;
+		if (!AddPoint(frame, &point, px, py))
+			break;
+	}
+
+	dx = x - cx2;
+	dy = y - cy2;
+	if (dx == 0 && dy == 0) { dx = x - cx1; dy = y - cy1; }
+	if (dx == 0 && dy == 0) { dx = x - x0; dy = y - y0; }
+	d = hypotf(dx, dy);
+	return EndCurve(frame, &point, x, y, dx / d, dy / d);
+}
+
+int DrawQuadTo(Frame* frame, int cx, int cy, int x, int y, int color)
+{
+	// The same curve as a cubic, with both control points two thirds of the way to (cx,cy).
+	int cx1 = frame->x_start + (int)lrintf(2.0f * (cx - frame->x_start) / 3);
+	int cy1 = frame->y_start + (int)lrintf(2.0f * (cy - frame->y_start) / 3);
+	int cx2 = x + (int)lrintf(2.0f * (cx - x) / 3);
+	int cy2 = y + (int)lrintf(2.0f * (cy - y) / 3);
+
+	return DrawCubicTo(frame, cx1, cy1, cx2, cy2, x, y, color);
+}
@@ -0,0 +1,32 @@
+//Curve primitives.  Circles, arcs and quadratic and cubic Béziers are written straight into
+//the frame in one pass, one point per step along the curve rather than a DrawLineTo (and a
+//dwell) per step.  The step follows the curvature: never more than divider, or with -motion
+//the distance the scanner covers in a sample at the speed its acceleration allows round the
+//bend, and short enough that no chord strays more than CURVE_TOLERANCE off the curve.  Arc
+//points come from a sine table, Bézier points from the polynomial, so no trigonometry is done
+//per point.
+//
+//Like DrawLineTo, each curve dwells at its end point.  With a recorder set a curve only moves
+//the pen; the path optimizer works on straight strokes.
+
+#include "main.h"
+
+#pragma once
+
+#define CURVE_TOLERANCE	1.0	//largest distance in DAC units between a chord and the curve
+
+//Draws the arc of a circle centered on (x,y), from angle start through sweep, both in degrees,
+//positive going from +x towards +y.  The pen moves there blanked if it is not at the start.
+//Returns the index of the last point written.
+int DrawArc(Frame* frame, int x, int y, int color, float radius, float start, float sweep);
+
+//Draws from the pen position to (x,y) along the quadratic Bézier with control point (cx,cy).
+//Returns the index of the last point written.
+int DrawQuadTo(Frame* frame, int cx, int cy, int x, int y, int color);
+
+//Draws from the pen position to (x,y) along the cubic Bézier with control points (cx1,cy1) and
+//(cx2,cy2).  Returns the index of the last point written.
+int DrawCubicTo(Frame* frame, int cx1, int cy1, int cx2, int cy2, int x, int y, int color);
+
+//As DrawArc, with no step longer than max_angle degrees.
+int DrawArcSteps(Frame* frame, int x, int y, int color, float radius, float start, float sweep, float max_angle);
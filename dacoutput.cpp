@@ -0,0 +1,427 @@
+//DAC output workers, see dacoutput.h
+
+#include "dacoutput.h"
+#include "correction.h"
+#include "edgesync.h"
+#include "rtmode.h"
+#include "scheduler.h"
+#include "stats.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int multi_dac = 0;
+int usb_async = 0;
+int hotplug = 0;
+int send_on_change = 0;
+DacLayout dac_layout[HELIOS_MAX_DEVICES];
+
+typedef struct
+{
+	HeliosDacClass* helios;
+	int dacNum;
+	WireFrame chunks[MAX_WIRE_CHUNKS];	//published frame packed for this DAC, with its offset applied
+	int num_chunks;	//more than 1 if it is over HELIOS_MAX_POINTS and played in parts
+	int next_chunk;	//to send next, of a frame played in parts
+	bool warned_size;
+	bool warned_chunks;
+	bool warned_failed;
+	unsigned long queued;	//generation last handed to HeliosAsync
+	unsigned long packed;	//generation in wire, with HeliosAsync
+	int connections;	//HeliosAsync::Connections when last queued to
+	struct timespec next_check;	//CLOCK_REALTIME, next keepalive with -send_on_change
+	HeliosDacClass::HeliosPoint corrected[HELIOS_MAX_POINTS];	//published frame corrected for this DAC
+	PointRun corrected_runs[HELIOS_MAX_POINTS];
+	PointRun chunk_runs[MAX_POINTS];	//frame over HELIOS_MAX_POINTS as runs, corrected if need be
+} DacWorker;
+
+typedef struct
+{
+	HeliosAsync* usb;
+	int numDacs;
+	DacWorker workers[HELIOS_MAX_DEVICES];
+} AsyncOutput;
+
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t output_cond = PTHREAD_COND_INITIALIZER;
+static const Frame* published = NULL;
+static unsigned long generation = 0;
+static uint8_t published_flags = 0;
+static bool hold_set = false;
+static struct timespec hold_from;
+
+//Packs a published frame over HELIOS_MAX_POINTS, as runs, cut into parts the DAC can take.
+//Returns the number of points packed.
+static int PackChunks(DacWorker* worker, const DacLayout* layout)
+{
+	const PointRun* runs = published->runs;
+	int num_runs = (published->num_runs < MAX_POINTS) ? published->num_runs : MAX_POINTS;
+	int dx = layout->dx;
+	int dy = layout->dy;
+	int packed;
+
+	if (runs == NULL) {
+		num_runs = EncodePointRuns(worker->chunk_runs, published->points, (published->num_points < MAX_POINTS) ? published->num_points : MAX_POINTS);
+		runs = worker->chunk_runs;
+	}
+	if (CorrectionEnabled()) {
+		CorrectRuns(worker->chunk_runs, runs, num_runs, dx, dy);
+		runs = worker->chunk_runs;
+		dx = dy = 0;
+	}
+	worker->num_chunks = PackWireChunks(worker->chunks, MAX_WIRE_CHUNKS, runs, num_runs, dx, dy, published->brightness, &packed);
+
+	if (!worker->warned_chunks) {
+		fprintf(stderr, "Frame of %d points is over the DAC limit of %d, played in %d parts..\n", published->num_points, HELIOS_MAX_POINTS, worker->num_chunks);
+		worker->warned_chunks = true;
+	}
+	return packed;
+}
+
+//Packs the published frame straight into the worker's wire format buffer, shifted by the
+//DAC's offset.  Repeats are then sent without any further conversion.  With a geometric
+//correction the frame is corrected first, a run's point once for the whole run.  A frame over
+//HELIOS_MAX_POINTS is packed into several, which are played once each and sent back to back.
+static void PackPublished(DacWorker* worker)
+{
+	const DacLayout* layout = &dac_layout[worker->dacNum];
+	WireFrame* wire = &worker->chunks[0];
+	int packed;
+
+	worker->num_chunks = 1;
+	worker->next_chunk = 0;
+	BeginWireFrame(wire);
+	if (published->num_points > HELIOS_MAX_POINTS) {
+		packed = PackChunks(worker, layout);
+	} else if (!CorrectionEnabled()) {
+		packed = (published->runs != NULL) ?
+				PackWireRuns(wire, published->runs, published->num_runs, layout->dx, layout->dy, published->brightness) :
+				PackWirePoints(wire, published->points, published->num_points, layout->dx, layout->dy, published->brightness);
+	} else if (published->runs != NULL) {
+		// Every run is at least a point, so no more runs than that fit anyway.
+		int num_runs = (published->num_runs < HELIOS_MAX_POINTS) ? published->num_runs : HELIOS_MAX_POINTS;
+		CorrectRuns(worker->corrected_runs, published->runs, num_runs, layout->dx, layout->dy);
+		packed = PackWireRuns(wire, worker->corrected_runs, num_runs, 0, 0, published->brightness);
+	} else {
+		int count = (published->num_points < HELIOS_MAX_POINTS) ? published->num_points : HELIOS_MAX_POINTS;
+		CorrectPoints(worker->corrected, published->points, count, layout->dx, layout->dy);
+		packed = PackWirePoints(wire, worker->corrected, count, 0, 0, published->brightness);
+	}
+	for (int i = 0; i < worker->num_chunks; i++)
+		CommitWireFrame(&worker->chunks[i], published->pps);
+
+	if (packed < published->num_points)
+		StatsFrameTruncated(worker->dacNum);
+	if (packed < published->num_points && !worker->warned_size) {
+		fprintf(stderr, "Frame of %d points is over the limit of %d, truncated..\n", published->num_points, packed);
+		worker->warned_size = true;
+	}
+}
+
+//Returns the flags for the next part of a frame played in parts: each is played once, and
+//the DAC takes the next as soon as it is done, so a frame only repeats while it is fed.
+static uint8_t ChunkFlags(const DacWorker* worker, uint8_t flags)
+{
+	if (worker->num_chunks <= 1)
+		return flags;
+	return (worker->next_chunk == 0 ? flags : 0) | HELIOS_FLAGS_SINGLE_MODE;
+}
+
+static void After(struct timespec* at, long ms)
+{
+	clock_gettime(CLOCK_REALTIME, at);
+	at->tv_sec += ms / 1000;
+	at->tv_nsec += (ms % 1000) * 1000000L;
+	if (at->tv_nsec >= 1000000000L) {
+		at->tv_sec++;
+		at->tv_nsec -= 1000000000L;
+	}
+}
+
+//Confirms a DAC left to loop its frame still answers.
+static void CheckDac(DacWorker* worker)
+{
+	bool ok = worker->helios->GetStatus(worker->dacNum) >= 0;
+
+	StatsKeepalive(worker->dacNum, ok);
+	if (!ok && !worker->warned_failed)
+		fprintf(stderr, "DAC %d is not answering status checks..\n", worker->dacNum);
+	worker->warned_failed = !ok;
+}
+
+static void* DacWorkerThread(void* arg)
+{
+	DacWorker* worker = (DacWorker*)arg;
+	unsigned long seen = 0;	//generation packed
+	unsigned long sent = 0;	//generation last taken by the DAC
+
+	while (1) {
+		struct timespec deadline;
+		uint8_t flags = 0;
+
+		pthread_mutex_lock(&output_lock);
+		if (send_on_change && worker->num_chunks <= 1) {
+			// Only a new frame is sent, the DAC repeats it; while there is none, check on the DAC.
+			// A frame the DAC has not taken yet is sent again until it does.  A frame played in
+			// parts cannot be left to the DAC, it is fed as without the option.
+			struct timespec check;
+			After(&check, KEEPALIVE_MS);
+			while (generation == sent && !DeadlineReached(&check))
+				pthread_cond_timedwait(&output_cond, &output_lock, &check);
+			if (generation == sent) {
+				pthread_mutex_unlock(&output_lock);
+				CheckDac(worker);
+				continue;
+			}
+		} else {
+			// Nothing to send until a frame is published, or while the current one is held.  The
+			// parts of a frame played in parts keep cycling, the DAC has nothing to loop.
+			while (generation == seen && (published == NULL ||
+					(hold_set && DeadlineReached(&hold_from) && worker->num_chunks <= 1)))
+				pthread_cond_wait(&output_cond, &output_lock);
+		}
+
+		if (generation != seen) {
+			PackPublished(worker);
+			seen = generation;
+		}
+		if (seen != sent)
+			flags = published_flags;
+
+		if (hold_set && worker->num_chunks <= 1) {
+			deadline = hold_from;
+		} else {
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec++;
+		}
+		pthread_mutex_unlock(&output_lock);
+
+		// A new frame always goes out, even past the hold time; repeats stop at the hold time.
+		if (seen != sent)
+			deadline.tv_sec++;
+		struct timespec ready;
+		int status = WaitForDac(*worker->helios, worker->dacNum, &deadline, &ready);
+		if (status != 1)
+			continue;
+
+		StatsReadyToSubmit(worker->dacNum, &ready);
+		if (SubmitFrame(*worker->helios, worker->dacNum, &worker->chunks[worker->next_chunk], ChunkFlags(worker, flags)) == 1) {
+			worker->next_chunk = (worker->next_chunk + 1) % worker->num_chunks;
+			sent = seen;
+		}
+	}
+
+	return NULL;
+}
+
+// Feeds every DAC from this one thread.  The transfers run asynchronously, so waiting on one
+// DAC never holds up another; this loop only hands new frames over and turns repeats on and off.
+static void* AsyncOutputThread(void* arg)
+{
+	AsyncOutput* output = (AsyncOutput*)arg;
+	HeliosAsync* usb = output->usb;
+	unsigned long seen = 0;
+
+	while (1) {
+		pthread_mutex_lock(&output_lock);
+		for (int i = 0; i < output->numDacs; i++) {
+			DacWorker* worker = &output->workers[i];
+
+			// A reconnected DAC has lost its frames, so the current one is queued again.
+			if (usb->Connections(i) != worker->connections) {
+				worker->connections = usb->Connections(i);
+				worker->queued = 0;
+				worker->warned_failed = false;
+			}
+
+			// Only DACs that are connected, which with -hotplug may be few of them, are packed for.
+			if (worker->packed != generation && !usb->Failed(i)) {
+				PackPublished(worker);
+				worker->packed = generation;
+			}
+		}
+		seen = generation;
+		uint8_t flags = published_flags;
+		bool feed = published != NULL && !(hold_set && DeadlineReached(&hold_from));
+		bool cycle = published != NULL;	//parts are fed through the hold too
+		pthread_mutex_unlock(&output_lock);
+
+		for (int i = 0; i < output->numDacs; i++) {
+			DacWorker* worker = &output->workers[i];
+
+			// Retried until there is room, a new frame always goes out, even past the hold time.
+			// The parts of a frame played in parts are queued one at a time after it, as the
+			// DAC takes them, instead of the DAC repeating the last frame, and through the hold
+			// time, or the DAC would go dark after the part it is on.
+			if (worker->packed == seen && worker->queued != seen && usb->QueueFrame(i, &worker->chunks[0], ChunkFlags(worker, flags))) {
+				worker->queued = seen;
+				worker->next_chunk = 1 % worker->num_chunks;
+			} else if (worker->num_chunks > 1 && worker->queued == seen && cycle && usb->QueuedFrames(i) == 0 &&
+					usb->QueueFrame(i, &worker->chunks[worker->next_chunk], ChunkFlags(worker, 0))) {
+				worker->next_chunk = (worker->next_chunk + 1) % worker->num_chunks;
+			}
+			usb->SetRepeat(i, feed && worker->queued == seen && !send_on_change && worker->num_chunks <= 1);
+
+			// With -send_on_change the DAC loops the frame, so it is only polled now and then.
+			if (send_on_change && DeadlineReached(&worker->next_check)) {
+				usb->CheckStatus(i);
+				After(&worker->next_check, KEEPALIVE_MS);
+			}
+
+			if (usb->Failed(i) && worker->connections > 0 && !worker->warned_failed) {
+				fprintf(stderr, "No longer feeding DAC %d..\n", i);
+				worker->warned_failed = true;
+			}
+		}
+
+		// Bounded by the poll interval so a newly published frame is picked up promptly.
+		if (!usb->HandleEvents(poll_us)) {
+			fprintf(stderr, "USB event handling failed..\n");
+			usleep(poll_us);
+		}
+	}
+
+	return NULL;
+}
+
+static long long RealtimeNanoseconds()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_REALTIME, &t);
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+// Writes the published frames to a sink, encoded straight from the frame under the lock.  The
+// sink takes the next frame when the one before has played out, as a DAC would.
+static void* SinkOutputThread(void* arg)
+{
+	FrameSink* sink = (FrameSink*)arg;
+	unsigned long seen = 0;
+	long long ready = RealtimeNanoseconds();
+
+	while (1) {
+		struct timespec at;
+		at.tv_sec = ready / 1000000000LL;
+		at.tv_nsec = ready % 1000000000LL;
+		SleepUntil(&at);
+
+		pthread_mutex_lock(&output_lock);
+		while (generation == seen && (published == NULL || (hold_set && DeadlineReached(&hold_from))))
+			pthread_cond_wait(&output_cond, &output_lock);
+
+		bool fresh = generation != seen;
+		uint8_t flags = fresh ? published_flags : 0;
+		int num_points = published->num_points;
+		int pps = published->pps;
+		seen = generation;
+		bool ok = WriteSinkFrame(sink, published, flags);
+		pthread_mutex_unlock(&output_lock);
+
+		if (!ok || !FinishSinkFrame(sink, fresh)) {
+			fprintf(stderr, "No longer writing frames to %s..\n", sink->name);
+			return NULL;
+		}
+
+		// After waiting for a frame the play time starts over from now, there is no backlog to catch up.
+		long long now = RealtimeNanoseconds();
+		if (ready < now)
+			ready = now;
+		ready += (num_points > 0 ? num_points : 1) * 1000000000LL / pps;
+	}
+
+	return NULL;
+}
+
+int StartSinkOutputs(FrameSink* sinks, int numSinks)
+{
+	for (int i = 0; i < numSinks; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, SinkOutputThread, &sinks[i]) != 0) {
+			fprintf(stderr, "Could not start output thread for %s..\n", sinks[i].name);
+			return 0;
+		}
+		pthread_detach(thread);
+	}
+	return 1;
+}
+
+int StartDacOutputs(HeliosDacClass* helios, int numDacs)
+{
+	for (int i = 0; i < numDacs; i++) {
+		DacWorker* worker = (DacWorker*)malloc(sizeof(DacWorker));
+		if (worker == NULL) {
+			fprintf(stderr, "Out of memory starting output for DAC %d..\n", i);
+			return 0;
+		}
+		worker->helios = helios;
+		worker->dacNum = i;
+		worker->warned_size = false;
+		worker->warned_chunks = false;
+		worker->warned_failed = false;
+		worker->queued = 0;
+		worker->num_chunks = 0;
+		worker->next_chunk = 0;
+		BeginWireFrame(&worker->chunks[0]);
+		PrefaultMemory(worker, sizeof(DacWorker));
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, DacWorkerThread, worker) != 0) {
+			fprintf(stderr, "Could not start output thread for DAC %d..\n", i);
+			free(worker);
+			return 0;
+		}
+		char name[16];
+		snprintf(name, sizeof(name), "DAC %d", i);
+		MakeOutputThreadRealtime(thread, name);
+		pthread_detach(thread);
+	}
+	return 1;
+}
+
+int StartAsyncDacOutputs(HeliosAsync* usb, int numDacs)
+{
+	AsyncOutput* output = (AsyncOutput*)calloc(1, sizeof(AsyncOutput));
+	if (output == NULL) {
+		fprintf(stderr, "Out of memory starting DAC output..\n");
+		return 0;
+	}
+	output->usb = usb;
+	output->numDacs = numDacs;
+	for (int i = 0; i < numDacs; i++) {
+		output->workers[i].dacNum = i;
+		BeginWireFrame(&output->workers[i].chunks[0]);
+	}
+	PrefaultMemory(output, sizeof(AsyncOutput));
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, AsyncOutputThread, output) != 0) {
+		fprintf(stderr, "Could not start DAC output thread..\n");
+		free(output);
+		return 0;
+	}
+	MakeOutputThreadRealtime(thread, "the DACs");
+	pthread_detach(thread);
+	return 1;
+}
+
+void PublishFrame(const Frame* frame, uint8_t flags)
+{
+	pthread_mutex_lock(&output_lock);
+	published = frame;
+	published_flags = flags;
+	generation++;
+	hold_set = false;
+	pthread_cond_broadcast(&output_cond);
+	pthread_mutex_unlock(&output_lock);
+}
+
+void HoldOutput(const struct timespec* from)
+{
+	pthread_mutex_lock(&output_lock);
+	hold_from = *from;
+	hold_set = true;
+	pthread_cond_broadcast(&output_cond);
+	pthread_mutex_unlock(&output_lock);
+}
@@ -0,0 +1,68 @@
+//DAC output workers.  Each DAC is fed by its own thread, so a slow USB transfer to one
+//projector does not hold up the others.  Frames are rendered once and published to all
+//workers, which pack them into the DAC wire format, shifted by the DAC's layout offset, and keep
+//their DAC fed.  With -usb_async a single thread feeds every DAC through HeliosAsync instead,
+//and with -hotplug that thread also picks up DACs as they are plugged in or come back.
+//Frame sinks get a thread each that takes the published frames the same way.
+//
+//A frame of more than HELIOS_MAX_POINTS is packed into the fewest DAC frames that hold it, cut
+//where the beam is blanked.  They are sent with HELIOS_FLAGS_SINGLE_MODE, so each is played
+//once, and the next is sent the moment the DAC is ready for it, while the one before is still
+//playing, so they follow each other with no gap.  If they are not fed in time the DAC stops
+//on a blanked point instead of looping a part of the frame.
+//
+//With -send_on_change a frame is only sent when a new one is published; the DAC loops it by
+//itself in between, and is sent a status check every KEEPALIVE_MS to confirm it still answers.
+//A frame played in parts is still fed continuously.
+
+#include "main.h"
+#include "framesink.h"
+#include "heliosasync.h"
+#include <time.h>
+
+#pragma once
+
+#define KEEPALIVE_MS	1000
+
+//Placement of one DAC's output relative to the rendered frame, set with -dac_offset.
+typedef struct
+{
+	int dx;
+	int dy;
+} DacLayout;
+
+//Non-zero to drive every discovered DAC instead of only DAC 0, set with -multi_dac.
+extern int multi_dac;
+
+//Non-zero to drive the DACs with asynchronous USB transfers from one thread, set with -usb_async.
+extern int usb_async;
+
+//Non-zero to send each frame once and let the DAC loop it, set with -send_on_change.
+extern int send_on_change;
+
+//Non-zero to start without waiting for the DACs, open them as they are plugged in and reopen any
+//that fail, set with -hotplug.  Implies -usb_async.
+extern int hotplug;
+
+extern DacLayout dac_layout[HELIOS_MAX_DEVICES];
+
+//Starts one output worker for each of the first numDacs DACs.  Returns 1 if successful.
+int StartDacOutputs(HeliosDacClass* helios, int numDacs);
+
+//Starts one thread that feeds the first numDacs DACs opened by usb, including any it opens
+//later.  Returns 1 if successful.
+int StartAsyncDacOutputs(HeliosAsync* usb, int numDacs);
+
+//Starts one thread for each sink that writes the published frames to it as a DAC would play
+//them.  Returns 1 if successful.
+int StartSinkOutputs(FrameSink* sinks, int numSinks);
+
+//Makes frame the one every DAC shows.  flags are used for the first write of it, later
+//repeats use 0.  The frame must stay untouched until the next PublishFrame.
+void PublishFrame(const Frame* frame, uint8_t flags);
+
+//Stops the workers from queueing further repeats of the current frame once CLOCK_REALTIME
+//reaches the given time, until the next PublishFrame.  The DACs keep looping it on their own.
+//A frame played in parts cannot be looped by the DAC, so its parts keep being fed through the
+//hold and only the switch to the next frame waits for it.
+void HoldOutput(const struct timespec* from);
@@ -0,0 +1,88 @@
+//Edge synchronized output, see edgesync.h
+
+#include "edgesync.h"
+#include "stats.h"
+#include <pthread.h>
+#include <stdio.h>
+
+int edge_sync = 0;
+int latency_us = -1;
+
+//Updated by every DAC's output thread.
+static pthread_mutex_t latency_lock = PTHREAD_MUTEX_INITIALIZER;
+static long measured_latency = 0;	//nanoseconds
+static bool latency_reported = false;
+
+static struct timespec AddNanoseconds(const struct timespec* t, long ns)
+{
+	struct timespec r = *t;
+	long long total = (long long)r.tv_nsec + ns;
+
+	r.tv_sec += total / 1000000000LL;
+	r.tv_nsec = total % 1000000000LL;
+	if (r.tv_nsec < 0) {
+		r.tv_sec--;
+		r.tv_nsec += 1000000000L;
+	}
+	return r;
+}
+
+static long ElapsedNanoseconds(const struct timespec* from, const struct timespec* to)
+{
+	return (to->tv_sec - from->tv_sec) * 1000000000L + (to->tv_nsec - from->tv_nsec);
+}
+
+long OutputLatency()
+{
+	if (latency_us >= 0)
+		return latency_us * 1000L;
+
+	pthread_mutex_lock(&latency_lock);
+	long latency = measured_latency;
+	pthread_mutex_unlock(&latency_lock);
+	return latency;
+}
+
+struct timespec SwitchTime(const struct timespec* edge)
+{
+	return AddNanoseconds(edge, -OutputLatency());
+}
+
+struct timespec FeedDeadline(const struct timespec* edge, int num_points, int pps)
+{
+	struct timespec switch_at = SwitchTime(edge);
+	long period = (long)(num_points * 1000000000LL / pps);
+
+	return AddNanoseconds(&switch_at, -period);
+}
+
+void RecordOutputLatency(long sample)
+{
+	pthread_mutex_lock(&latency_lock);
+	if (measured_latency == 0)
+		measured_latency = sample;
+	else
+		measured_latency += (sample - measured_latency) / LATENCY_SMOOTHING;
+
+	if (latency_us < 0 && !latency_reported) {
+		fprintf(stderr, "Measured output latency: %ld us\n", measured_latency / 1000);
+		latency_reported = true;
+	}
+	pthread_mutex_unlock(&latency_lock);
+}
+
+int SubmitFrame(HeliosDacClass& helios, int dacNum, WireFrame* wire, uint8_t flags)
+{
+	struct timespec start, end;
+
+	// With start immediately the frame lights up as soon as the transfer is done.
+	clock_gettime(CLOCK_REALTIME, &start);
+	int status = SendWireFrame(helios, dacNum, wire, flags);
+	clock_gettime(CLOCK_REALTIME, &end);
+
+	long elapsed = ElapsedNanoseconds(&start, &end);
+	StatsFrameSent(dacNum, wire, elapsed, status == 1);
+	if (flags & HELIOS_FLAGS_START_IMMEDIATELY)
+		RecordOutputLatency(elapsed);
+	return status;
+}
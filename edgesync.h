@@ -0,0 +1,35 @@
+//Edge synchronized output.  Sends each new frame ahead of the second edge by the time it takes
+//to reach the projector, with HELIOS_FLAGS_START_IMMEDIATELY so it replaces the playing frame
+//at once, and stops queueing the old frame one frame period before that so the DAC is free.
+//The latency is either given with -latency_us or measured from the frame transfers.
+
+#include "main.h"
+#include "wireframe.h"
+#include <time.h>
+
+#pragma once
+
+#define LATENCY_SMOOTHING	8	//measured latency is averaged over roughly this many samples
+
+//Non-zero to switch frames on the true second edge, set with -edge_sync.
+extern int edge_sync;
+
+//WriteFrame-to-light latency in microseconds, set with -latency_us.  -1 measures it.
+extern int latency_us;
+
+//Returns the latency currently used, in nanoseconds.
+long OutputLatency();
+
+//Returns when the frame for the second starting at edge should be sent.
+struct timespec SwitchTime(const struct timespec* edge);
+
+//Returns when to stop queueing a frame of num_points that is to be replaced at the given edge.
+struct timespec FeedDeadline(const struct timespec* edge, int num_points, int pps);
+
+//Adds one measurement of the time from starting a start-immediately send to its completion,
+//in nanoseconds.  Called from any output thread.
+void RecordOutputLatency(long sample);
+
+//Sends a committed wire frame to the DAC.  Every send is timed for the stats, and sends that
+//start a new frame also measure the latency.  Returns the SendWireFrame result.
+int SubmitFrame(HeliosDacClass& helios, int dacNum, WireFrame* wire, uint8_t flags);
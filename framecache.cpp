@@ -0,0 +1,206 @@
+//Day of frames cache, see framecache.h
+
+#include "framecache.h"
+#include "clockframe.h"
+#include "motion.h"
+#include "pathopt.h"
+#include "pointbudget.h"
+#include "pointruns.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char* frame_cache = NULL;
+
+static const uint32_t* cache_offsets = NULL;
+static const PointRun* cache_runs;
+
+//Runs start on a PointRun boundary after the header and offset table.
+static size_t RunsOffset()
+{
+	size_t offset = sizeof(FrameCacheHeader) + (FRAMES_PER_DAY + 1) * sizeof(uint32_t);
+	size_t align = sizeof(PointRun);
+
+	return (offset + align - 1) / align * align;
+}
+
+static void CurrentKey(FrameCacheKey* key)
+{
+	memset(key, 0, sizeof(*key));
+	key->xpos = xpos;
+	key->ypos = ypos;
+	key->size = size;
+	key->color = color;
+	key->divider = divider;
+	key->dwell = dwell;
+	key->hidden_dwell = hidden_dwell;
+	key->optimize_path = optimize_path;
+	key->motion = motion;
+	key->scan_speed = scan_speed;
+	key->scan_accel = scan_accel;
+	key->auto_budget = auto_budget;
+	key->target_fps = target_fps;
+	key->adapt_pps = adapt_pps;
+	key->max_pps = max_pps;
+}
+
+static void CurrentHeader(FrameCacheHeader* header)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, "LCFC", 4);
+	header->version = FRAME_CACHE_VERSION;
+	header->run_size = sizeof(PointRun);
+	header->num_frames = FRAMES_PER_DAY;
+	CurrentKey(&header->key);
+}
+
+//Renders every second of the day into a temporary file and renames it over the cache, so a
+//cache that is there is always complete.  Returns false if the file could not be written.
+static bool BuildFrameCache()
+{
+	static ClockFrame clock;
+	static uint32_t offsets[FRAMES_PER_DAY + 1];
+	static PointRun runs[MAX_POINTS];
+	FrameCacheHeader header;
+	char temp[1024];
+
+	if (!InitClockFrame(&clock)) {
+		fprintf(stderr, "Out of memory for the frame..\n");
+		return false;
+	}
+
+	snprintf(temp, sizeof(temp), "%s.tmp", frame_cache);
+	FILE* f = fopen(temp, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "Could not create frame cache %s: %s..\n", temp, strerror(errno));
+		return false;
+	}
+	fprintf(stderr, "Rendering frame cache %s for these settings..\n", frame_cache);
+
+	// The runs go in first, after room for the header and table, which are only known at the end.
+	CurrentHeader(&header);
+	bool ok = fseek(f, RunsOffset(), SEEK_SET) == 0;
+	uint32_t total = 0;
+	unsigned long points = 0;
+
+	for (int n = 0; n < FRAMES_PER_DAY && ok; n++) {
+		struct tm tm;
+		memset(&tm, 0, sizeof(tm));
+		tm.tm_hour = n / 3600;
+		tm.tm_min = (n / 60) % 60;
+		tm.tm_sec = n % 60;
+
+		BuildBudgetedClockFrame(&clock, &tm);
+		int num_runs = EncodePointRuns(runs, clock.frame.points, clock.frame.num_points);
+		offsets[n] = total;
+		total += num_runs;
+		points += clock.frame.num_points;
+		ok = fwrite(runs, sizeof(*runs), num_runs, f) == (size_t)num_runs;
+	}
+	offsets[FRAMES_PER_DAY] = total;
+
+	ok = ok && fseek(f, 0, SEEK_SET) == 0;
+	ok = ok && fwrite(&header, sizeof(header), 1, f) == 1;
+	ok = ok && fwrite(offsets, sizeof(offsets), 1, f) == 1;
+	ok = (fclose(f) == 0) && ok;
+	ok = ok && rename(temp, frame_cache) == 0;
+
+	if (!ok) {
+		fprintf(stderr, "Could not write frame cache %s: %s..\n", frame_cache, strerror(errno));
+		unlink(temp);
+		return false;
+	}
+	fprintf(stderr, "Frame cache %s: %lu points in %u runs, %.1f MB..\n", frame_cache, points, total,
+			(RunsOffset() + (double)total * sizeof(PointRun)) / 1e6);
+	return true;
+}
+
+//Maps the cache file if it is complete and matches the current settings.
+static bool MapFrameCache(bool complain)
+{
+	FrameCacheHeader header;
+	struct stat st;
+
+	int fd = open(frame_cache, O_RDONLY);
+	if (fd < 0) {
+		if (complain)
+			fprintf(stderr, "Could not open frame cache %s: %s..\n", frame_cache, strerror(errno));
+		return false;
+	}
+
+	CurrentHeader(&header);
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < RunsOffset()) {
+		close(fd);
+		return false;
+	}
+
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		if (complain)
+			fprintf(stderr, "Could not map frame cache %s: %s..\n", frame_cache, strerror(errno));
+		return false;
+	}
+
+	// Stale if made with other settings, or by a build with another run layout.
+	const uint8_t* bytes = (const uint8_t*)map;
+	const uint32_t* offsets = (const uint32_t*)(bytes + sizeof(FrameCacheHeader));
+	size_t expected = RunsOffset() + (size_t)offsets[FRAMES_PER_DAY] * sizeof(PointRun);
+	if (memcmp(bytes, &header, sizeof(header)) != 0 || (size_t)st.st_size != expected) {
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	// Each second's runs must follow the last's, or a damaged file would have them read past the
+	// mapping.  No frame has more runs than points.
+	bool ordered = offsets[0] == 0;
+	for (int n = 0; ordered && n < FRAMES_PER_DAY; n++)
+		ordered = offsets[n] <= offsets[n + 1] && offsets[n + 1] - offsets[n] <= MAX_POINTS;
+	if (!ordered) {
+		if (complain)
+			fprintf(stderr, "Frame cache %s is damaged..\n", frame_cache);
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	cache_offsets = offsets;
+	cache_runs = (const PointRun*)(bytes + RunsOffset());
+	return true;
+}
+
+bool OpenFrameCache()
+{
+	if (MapFrameCache(false))
+		return true;
+
+	// Rendering the day moves the settings about with -auto_budget, so each day starts from scratch.
+	ResetPointBudget();
+	bool built = BuildFrameCache();
+	ResetPointBudget();
+
+	return built && MapFrameCache(true);
+}
+
+void CachedFrame(Frame* view, time_t t)
+{
+	struct tm tm;
+
+	localtime_r(&t, &tm);
+
+	// A leap second shows as the second before it.
+	int sec = tm.tm_sec < 60 ? tm.tm_sec : 59;
+	int n = tm.tm_hour * 3600 + tm.tm_min * 60 + sec;
+
+	ClearFrame(view);
+	view->runs = &cache_runs[cache_offsets[n]];
+	view->num_runs = cache_offsets[n + 1] - cache_offsets[n];
+
+	// Only depend on the runs, so they are not cached.
+	view->num_points = RunPointCount(view->runs, view->num_runs);
+	SetFrameRate(view);
+}
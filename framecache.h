@@ -0,0 +1,59 @@
+//Day of frames cache.  A clock frame only depends on HH:MM:SS and the render settings, so with
+//-frame_cache all 86400 frames are rendered once into a file, which is then memory mapped.
+//Showing a second is an index lookup, and the frame handed to the DAC outputs is runs straight
+//in the mapping; nothing is rendered or copied.  The file starts with the settings it was
+//rendered with and is rebuilt whenever they differ from the current ones.
+//
+//Layout: a FrameCacheHeader, an offset table of FRAMES_PER_DAY + 1 run indexes (frame n is the
+//runs from offsets[n] up to offsets[n+1]), then the runs as PointRun records (see pointruns.h),
+//all in host byte order.  At 10 bytes a run a day takes about 86 MB for every 100 runs in a
+//frame, and as dwell and blank jumps are one run each, a frame has far fewer runs than points.
+
+#include "main.h"
+#include <stdint.h>
+#include <time.h>
+
+#pragma once
+
+#define FRAMES_PER_DAY		86400
+#define FRAME_CACHE_VERSION	4	//also changes with the shapes of the glyphs, which the settings do not cover
+
+//Everything a clock frame depends on.
+typedef struct
+{
+	int xpos;
+	int ypos;
+	int size;
+	int color;
+	float divider;
+	int dwell;
+	int hidden_dwell;
+	int optimize_path;
+	int motion;
+	float scan_speed;
+	float scan_accel;
+	int auto_budget;
+	int target_fps;
+	int adapt_pps;
+	int max_pps;
+} FrameCacheKey;
+
+typedef struct
+{
+	char magic[4];		//"LCFC"
+	uint32_t version;	//FRAME_CACHE_VERSION
+	uint32_t run_size;	//sizeof(PointRun)
+	uint32_t num_frames;	//FRAMES_PER_DAY
+	FrameCacheKey key;
+} FrameCacheHeader;
+
+//Cache file, set with -frame_cache.  NULL renders every second as usual.
+extern const char* frame_cache;
+
+//Maps the cache file for the current settings, rendering it first if it is missing or was made
+//with other settings.  Returns false, with a message, if the cache cannot be used.
+bool OpenFrameCache();
+
+//Points view at the cached frame's runs for the local time t, with its point rate and brightness.  The runs are read only and
+//stay valid for as long as the program runs.
+void CachedFrame(Frame* view, time_t t);
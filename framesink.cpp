@@ -0,0 +1,348 @@
+//Frame sinks, see framesink.h
+
+#include "framesink.h"
+#include "clockframe.h"
+#include "pointruns.h"
+#include "renderthread.h"
+#include "wireframe.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const char* ilda_file = NULL;
+const char* stream_to = NULL;
+int sink_seconds = 0;
+
+// A whole frame always fits, so a frame is never split across two writes.
+static_assert(SINK_BUFFER_SIZE >= 2 * ILDA_HEADER_SIZE + MAX_POINTS * ILDA_POINT_SIZE, "sink buffer too small");
+static_assert(SINK_BUFFER_SIZE >= STREAM_HEADER_SIZE + MAX_POINTS * STREAM_RUN_SIZE, "sink buffer too small");
+
+static bool InitSink(FrameSink* sink, const char* name, int format, int fd, bool socket)
+{
+	sink->buffer = (uint8_t*)malloc(SINK_BUFFER_SIZE);
+	if (sink->buffer == NULL) {
+		fprintf(stderr, "Out of memory for the output to %s..\n", name);
+		return false;
+	}
+	sink->name = name;
+	sink->format = format;
+	sink->fd = fd;
+	sink->socket = socket;
+	sink->used = 0;
+	sink->last_size = 0;
+	sink->frames = 0;
+	return true;
+}
+
+static int OpenFile(const char* path)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0)
+		fprintf(stderr, "Could not open %s: %s..\n", path, strerror(errno));
+	return fd;
+}
+
+//Connects to host:port over TCP.  Returns -1 if it cannot.
+static int Connect(const char* to)
+{
+	char host[256];
+	const char* colon = strrchr(to, ':');
+	int length = colon - to;
+
+	if (length <= 0 || length >= (int)sizeof(host)) {
+		fprintf(stderr, "Bad stream address %s, use host:port..\n", to);
+		return -1;
+	}
+	memcpy(host, to, length);
+	host[length] = 0;
+
+	struct addrinfo hints, *addrs;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	int err = getaddrinfo(host, colon + 1, &hints, &addrs);
+	if (err != 0) {
+		fprintf(stderr, "Could not resolve %s: %s..\n", to, gai_strerror(err));
+		return -1;
+	}
+
+	int fd = -1;
+	for (struct addrinfo* a = addrs; a != NULL && fd < 0; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(addrs);
+
+	if (fd < 0) {
+		fprintf(stderr, "Could not connect to %s..\n", to);
+		return -1;
+	}
+
+	// Frames are written whole, so there is nothing to gain from holding them back.
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+bool OpenIldaSink(FrameSink* sink, const char* path)
+{
+	int fd = OpenFile(path);
+
+	if (fd < 0)
+		return false;
+	if (!InitSink(sink, path, SINK_ILDA, fd, false)) {
+		close(fd);
+		return false;
+	}
+	return true;
+}
+
+bool OpenStreamSink(FrameSink* sink, const char* to)
+{
+	bool socket = false;
+	int fd;
+
+	if (strcmp(to, "-") == 0) {
+		fd = STDOUT_FILENO;
+	} else if (strchr(to, ':') != NULL) {
+		fd = Connect(to);
+		socket = true;
+	} else {
+		fd = OpenFile(to);
+	}
+	if (fd < 0)
+		return false;
+
+	// A reader going away shows up as a failed write rather than killing the clock.
+	signal(SIGPIPE, SIG_IGN);
+
+	if (!InitSink(sink, to, SINK_STREAM, fd, socket)) {
+		if (fd != STDOUT_FILENO)
+			close(fd);
+		return false;
+	}
+	return true;
+}
+
+bool FlushSink(FrameSink* sink)
+{
+	int done = 0;
+
+	while (done < sink->used) {
+		ssize_t n = sink->socket ? send(sink->fd, sink->buffer + done, sink->used - done, MSG_NOSIGNAL) :
+				write(sink->fd, sink->buffer + done, sink->used - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			fprintf(stderr, "Writing frames to %s failed: %s..\n", sink->name, n < 0 ? strerror(errno) : "closed");
+			sink->used = 0;
+			return false;
+		}
+		done += n;
+	}
+	sink->used = 0;
+	return true;
+}
+
+static uint8_t* PutBigEndian16(uint8_t* out, int v)
+{
+	out[0] = (v >> 8) & 0xFF;
+	out[1] = v & 0xFF;
+	return out + 2;
+}
+
+static void IldaHeader(uint8_t* out, int records, unsigned long number)
+{
+	memset(out, 0, ILDA_HEADER_SIZE);
+	memcpy(out, "ILDA", 4);
+	out[7] = 5;	//2D true color
+	memcpy(&out[8], "laserclk", 8);
+
+	// The total number of frames is not known while they are being written, so it is left 0.
+	PutBigEndian16(&out[24], records);
+	PutBigEndian16(&out[26], (int)(number & 0xFFFF));
+}
+
+//ILDA coordinates are signed 16 bit around the center.
+static int IldaCoordinate(int v)
+{
+	return (v - 2048) * 16;
+}
+
+//Takes the next run of the frame from *next on, whether the frame holds runs or points.
+//Returns its length, 0 after the last one.
+static int NextRun(const Frame* frame, int* next, const HeliosDacClass::HeliosPoint** point)
+{
+	if (frame->runs != NULL) {
+		if (*next >= frame->num_runs)
+			return 0;
+		*point = &frame->runs[*next].point;
+		return frame->runs[(*next)++].count;
+	}
+
+	if (*next >= frame->num_points)
+		return 0;
+	*point = &frame->points[*next];
+	int n = PointRunLength(*point, frame->num_points - *next);
+	*next += n;
+	return n;
+}
+
+//ILDA has no runs, so each run is written out point by point.
+static void EncodeIlda(uint8_t* out, const Frame* frame, int count, unsigned long number)
+{
+	// An ILDA frame without points ends the file, so an empty frame is played as one blanked point.
+	static const HeliosDacClass::HeliosPoint blank = { 2048, 2048, 0, 0, 0, 0 };
+	const HeliosDacClass::HeliosPoint* p = &blank;
+	int brightness = frame->brightness;
+	int total = (count > 0) ? count : 1;
+	int next = 0;
+	int n = 0;
+
+	IldaHeader(out, total, number);
+	out += ILDA_HEADER_SIZE;
+
+	for (int i = 0; i < total; i++) {
+		if (n == 0 && count > 0)
+			n = NextRun(frame, &next, &p);
+		n--;
+
+		int r = (p->r * brightness) / FULL_BRIGHTNESS;
+		int g = (p->g * brightness) / FULL_BRIGHTNESS;
+		int b = (p->b * brightness) / FULL_BRIGHTNESS;
+		bool blanked = p->i == 0 || (r == 0 && g == 0 && b == 0);
+
+		out = PutBigEndian16(out, IldaCoordinate(p->x));
+		out = PutBigEndian16(out, IldaCoordinate(p->y));
+		out[0] = (i == total - 1 ? 0x80 : 0) | (blanked ? 0x40 : 0);
+		out[1] = b;
+		out[2] = g;
+		out[3] = r;
+		out += 4;
+	}
+}
+
+//Returns the size written, which depends on how many runs the count points make.
+static int EncodeStream(uint8_t* out, const Frame* frame, int count, uint8_t flags)
+{
+	uint8_t* run = out + STREAM_HEADER_SIZE;
+	const HeliosDacClass::HeliosPoint* p;
+	int num_runs = 0;
+	int next = 0;
+	int n;
+
+	for (int left = count; left > 0 && (n = NextRun(frame, &next, &p)) > 0; left -= n) {
+		if (n > left)
+			n = left;
+		EncodeWirePoints(run, p, 1, 0, 0, frame->brightness);
+		run[WIRE_POINT_SIZE] = n & 0xFF;
+		run[WIRE_POINT_SIZE + 1] = n >> 8;
+		run += STREAM_RUN_SIZE;
+		num_runs++;
+	}
+
+	out[0] = 'L';
+	out[1] = 'F';
+	out[2] = num_runs & 0xFF;
+	out[3] = num_runs >> 8;
+	out[4] = frame->pps & 0xFF;
+	out[5] = (frame->pps >> 8) & 0xFF;
+	out[6] = flags;
+	out[7] = STREAM_RUNS;
+	return run - out;
+}
+
+bool WriteSinkFrame(FrameSink* sink, const Frame* frame, uint8_t flags)
+{
+	int count = frame->num_points;
+	if (count > MAX_POINTS)
+		count = MAX_POINTS;
+
+	// A stream frame is never larger than one run per point.
+	int size = (sink->format == SINK_ILDA) ?
+			ILDA_HEADER_SIZE + (count > 0 ? count : 1) * ILDA_POINT_SIZE :
+			STREAM_HEADER_SIZE + count * STREAM_RUN_SIZE;
+
+	// Room is kept for the ILDA end header as well.
+	if (sink->used + size + ILDA_HEADER_SIZE > SINK_BUFFER_SIZE && !FlushSink(sink))
+		return false;
+
+	uint8_t* out = &sink->buffer[sink->used];
+	if (sink->format == SINK_ILDA)
+		EncodeIlda(out, frame, count, sink->frames);
+	else
+		size = EncodeStream(out, frame, count, flags);
+
+	sink->used += size;
+	sink->last_size = size;
+	sink->frames++;
+	return true;
+}
+
+bool FinishSinkFrame(FrameSink* sink, bool fresh)
+{
+	// Also flushed here if another frame like this one would not fit, so WriteSinkFrame, which
+	// runs under the output lock, should seldom have to.
+	if (sink->format == SINK_STREAM || fresh || sink->used + sink->last_size + ILDA_HEADER_SIZE > SINK_BUFFER_SIZE)
+		return FlushSink(sink);
+	return true;
+}
+
+void CloseSink(FrameSink* sink)
+{
+	if (sink->buffer == NULL)
+		return;
+
+	if (sink->format == SINK_ILDA) {
+		IldaHeader(&sink->buffer[sink->used], 0, sink->frames);
+		sink->used += ILDA_HEADER_SIZE;
+	}
+	FlushSink(sink);
+
+	if (sink->fd != STDOUT_FILENO)
+		close(sink->fd);
+	free(sink->buffer);
+	sink->buffer = NULL;
+}
+
+bool RenderToSinks(FrameSink* sinks, int numSinks, time_t t, int seconds)
+{
+	static ClockFrame clock;
+
+	if (!InitClockFrame(&clock)) {
+		fprintf(stderr, "Out of memory for the frame..\n");
+		return false;
+	}
+
+	for (int s = 0; s < seconds; s++) {
+		RenderClockFrame(&clock, t + s);
+
+		// As many plays as fit in the second, as the DAC would repeat it.
+		const Frame* frame = &clock.frame;
+		int plays = (frame->num_points > 0) ? (frame->pps + frame->num_points / 2) / frame->num_points : 1;
+		if (plays < 1)
+			plays = 1;
+
+		for (int i = 0; i < numSinks; i++) {
+			for (int n = 0; n < plays; n++) {
+				if (!WriteSinkFrame(&sinks[i], frame, 0))
+					return false;
+			}
+			if (!FinishSinkFrame(&sinks[i], true))
+				return false;
+		}
+	}
+	return true;
+}
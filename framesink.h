@@ -0,0 +1,76 @@
+//Frame sinks.  Rendered frames can be written to an ILDA file with -ilda_file, or streamed with
+//-stream to stdout, a file or a TCP connection, instead of or as well as going to the DACs.  A
+//sink is fed like a DAC: every repeat of the published frame is written as a DAC would play it,
+//paced at the frame's point rate.  With -sink_seconds the clock is rendered that many seconds ahead
+//as fast as it can be, each second written as many times as it would play, and then the program
+//exits; this pre-generates content for a show controller.
+//
+//Points, or the frame's runs (see pointruns.h), are encoded from the frame straight into the sink's write buffer, which goes out in
+//batches: after every frame for a stream, once a new frame is published for a file.
+//
+//ILDA files use format 5 (2D true color) with one ILDA frame per play of a frame, and end with
+//the usual empty header.  The stream is a sequence of frames, each an 8 byte header, "LF", the
+//number of runs and the pps (both LSB first), the WriteFrame flags and the format, STREAM_RUNS,
+//followed by 9 bytes per run: the point, 7 bytes in the Helios wire format (see wireframe.h),
+//and the number of times it is played (LSB first).  A dwell or a blank jump is one run.
+
+#include "main.h"
+#include "wireframe.h"
+#include <time.h>
+
+#pragma once
+
+#define SINK_ILDA	0
+#define SINK_STREAM	1
+
+#define SINK_BUFFER_SIZE	(1 << 17)
+#define ILDA_HEADER_SIZE	32
+#define ILDA_POINT_SIZE		8
+#define STREAM_HEADER_SIZE	8
+#define STREAM_RUN_SIZE		(WIRE_POINT_SIZE + 2)
+#define STREAM_RUNS		1	//format byte of a frame of runs
+
+typedef struct
+{
+	const char* name;	//path or address, for messages
+	int format;		//SINK_ILDA or SINK_STREAM
+	int fd;
+	bool socket;
+	uint8_t* buffer;	//SINK_BUFFER_SIZE bytes, used of them pending
+	int used;
+	int last_size;		//bytes of the last frame written
+	unsigned long frames;	//frames written so far
+} FrameSink;
+
+//ILDA file to write, set with -ilda_file.  NULL writes none.
+extern const char* ilda_file;
+
+//Where to stream frames, set with -stream: "-" for stdout, host:port to connect over TCP, else
+//a file name.  NULL streams nothing.
+extern const char* stream_to;
+
+//Seconds to render ahead into the sinks before exiting, set with -sink_seconds.  0 runs live.
+extern int sink_seconds;
+
+//Opens an ILDA file sink.  Returns false, with a message, if it cannot.
+bool OpenIldaSink(FrameSink* sink, const char* path);
+
+//Opens a stream sink to the destination as given with -stream.  Returns false, with a message, if it cannot.
+bool OpenStreamSink(FrameSink* sink, const char* to);
+
+//Encodes the frame, at its point rate and brightness, into the sink's buffer, flushing first if
+//there is no room.  Returns false if a flush failed.
+bool WriteSinkFrame(FrameSink* sink, const Frame* frame, uint8_t flags);
+
+//Flushes the buffer as the sink's batching calls for, after a frame was written.  fresh is true
+//for the first write of a newly published frame.  Returns false if writing failed.
+bool FinishSinkFrame(FrameSink* sink, bool fresh);
+
+//Writes out everything buffered.  Returns false if writing failed.
+bool FlushSink(FrameSink* sink);
+
+//Ends the file if the format has an end marker, flushes and closes.
+void CloseSink(FrameSink* sink);
+
+//Renders the seconds from t on, for -sink_seconds.  Returns false if a sink failed.
+bool RenderToSinks(FrameSink* sinks, int numSinks, time_t t, int seconds);
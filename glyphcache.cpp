@@ -0,0 +1,234 @@
+//Glyph cache, see glyphcache.h
+
+#include "glyphcache.h"
+#include "linekernel.h"
+#include "motion.h"
+#include "pointruns.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+	int first;	//index of the first run in glyph_runs
+	int num_runs;
+	int count;	//points the runs expand to
+	int start_x;	//first visible vertex, relative to the origin
+	int start_y;
+	int end_x;	//pen position after the glyph, relative to the origin
+	int end_y;
+	int min_x;	//bounding box of the points, relative to the origin
+	int min_y;
+	int max_x;
+	int max_y;
+} Glyph;
+
+typedef struct
+{
+	int size;
+	int color;
+	float divider;
+	int dwell;
+	int hidden_dwell;
+	int motion;
+	float scan_speed;
+	float scan_accel;
+} GlyphKey;
+
+static Glyph glyphs[NUM_GLYPHS];
+static StrokeList glyph_strokes[NUM_GLYPHS];
+static PointRun* glyph_runs = NULL;
+static int glyph_capacity = 0;
+static GlyphKey glyph_key;
+static bool glyph_valid = false;
+static int glyph_generation = 0;
+
+//Scratch frame the glyphs are traced into.
+static Frame trace_frame;
+
+//Glyphs are traced near the origin, with every coordinate positive so the kernel's clamp to the
+//DAC range leaves them whole, and copied out moved by whole units.  That matches drawing them in
+//place: the 16.16 kernel's steps depend only on a line's extent, so moving its start by a whole
+//unit moves every point it makes by exactly that.
+static void TraceGlyph(Frame* frame, int n)
+{
+	if (n == GLYPH_COLON) {
+		int square = size/10;
+		DrawSquare(frame, square/2, square/2, color, square);
+	} else {
+		DrawDigit(frame, n, 0, 2*size, color, size);
+	}
+}
+
+int GlyphCacheUpdate()
+{
+	GlyphKey key;
+	Frame* frame = &trace_frame;
+
+	memset(&key, 0, sizeof(key));
+	key.size = size;
+	key.color = color;
+	key.divider = divider;
+	key.dwell = dwell;
+	key.hidden_dwell = hidden_dwell;
+	key.motion = motion;
+	key.scan_speed = scan_speed;
+	key.scan_accel = scan_accel;
+
+	if (glyph_valid && memcmp(&key, &glyph_key, sizeof(key)) == 0)
+		return 0;
+
+	if (!InitFrame(frame)) {
+		fprintf(stderr, "Glyph cache: out of memory..\n");
+		return -1;
+	}
+
+	glyph_valid = false;
+	int used = 0;
+
+	for (int n = 0; n < NUM_GLYPHS; n++) {
+		// Trace the vertex geometry the path optimizer works on first, it gives the glyph's start.
+		glyph_strokes[n].num_strokes = 0;
+		glyph_strokes[n].pen_down = false;
+		ClearFrame(frame);
+		frame->recorder = &glyph_strokes[n];
+		TraceGlyph(frame, n);
+		frame->recorder = NULL;
+		FinishStrokes(&glyph_strokes[n]);
+
+		glyphs[n].start_x = glyph_strokes[n].num_strokes ? glyph_strokes[n].strokes[0].x[0] : 0;
+		glyphs[n].start_y = glyph_strokes[n].num_strokes ? glyph_strokes[n].strokes[0].y[0] : 0;
+
+		// With -motion the blank jump into a glyph is sized by where the pen really comes from,
+		// so it is left out here and drawn when the glyph is copied.
+		ClearFrame(frame);
+		if (motion) {
+			frame->x_start = glyphs[n].start_x;
+			frame->y_start = glyphs[n].start_y;
+		}
+		TraceGlyph(frame, n);
+		int count = frame->num_points;
+
+		// Room for the worst case of one run per point.
+		if (used + count > glyph_capacity) {
+			int capacity = (used + count) * 2;
+			PointRun* runs = (PointRun*)realloc(glyph_runs, capacity * sizeof(*runs));
+			if (runs == NULL) {
+				fprintf(stderr, "Glyph cache: out of memory..\n");
+				return -1;
+			}
+			glyph_runs = runs;
+			glyph_capacity = capacity;
+		}
+
+		glyphs[n].first = used;
+		glyphs[n].num_runs = EncodePointRuns(&glyph_runs[used], frame->points, count);
+		glyphs[n].count = count;
+		glyphs[n].end_x = frame->x_start;
+		glyphs[n].end_y = frame->y_start;
+		glyphs[n].min_x = glyphs[n].min_y = 4095;
+		glyphs[n].max_x = glyphs[n].max_y = 0;
+		for (int i = 0; i < count; i++) {
+			const HeliosDacClass::HeliosPoint* p = &frame->points[i];
+			if (p->x < glyphs[n].min_x) glyphs[n].min_x = p->x;
+			if (p->x > glyphs[n].max_x) glyphs[n].max_x = p->x;
+			if (p->y < glyphs[n].min_y) glyphs[n].min_y = p->y;
+			if (p->y > glyphs[n].max_y) glyphs[n].max_y = p->y;
+		}
+		used += glyphs[n].num_runs;
+	}
+
+	glyph_key = key;
+	glyph_valid = true;
+	glyph_generation++;
+
+	return 1;
+}
+
+int GlyphCacheGeneration()
+{
+	return glyph_generation;
+}
+
+//Copies a cached glyph into the frame offset by (dx,dy).  Clipping is decided once from the
+//glyph's bounding box, so a glyph that is fully on screen is copied without any per-point checks.
+//Each run's point is translated once and then filled in for the length of the run.
+static int CopyGlyph(Frame* frame, int n, int dx, int dy)
+{
+	const Glyph* glyph = &glyphs[n];
+	const PointRun* src = &glyph_runs[glyph->first];
+
+	if (motion && (frame->x_start != glyph->start_x + dx || frame->y_start != glyph->start_y + dy))
+		DrawLineTo(frame, glyph->start_x + dx, glyph->start_y + dy, 0);
+
+	int count = FrameRoom(frame, glyph->count);
+
+	HeliosDacClass::HeliosPoint* dst = &frame->points[frame->num_points];
+	bool outside_x = glyph->min_x + dx < 0 || glyph->max_x + dx > 4095;
+	bool outside_y = glyph->min_y + dy < 0 || glyph->max_y + dy > 4095;
+
+	if (outside_x || outside_y)
+		NoteClipping(glyph->max_x + dx > 4095, glyph->max_y + dy > 4095);
+
+	int copied = 0;
+	for (int i = 0; i < glyph->num_runs && copied < count; i++) {
+		HeliosDacClass::HeliosPoint point = src[i].point;
+
+		if (!outside_x && !outside_y) {
+			point.x += dx;
+			point.y += dy;
+		} else {
+			int x = point.x + dx;
+			int y = point.y + dy;
+			point.x = (x < 0) ? 0 : (x > 4095) ? 4095 : x;
+			point.y = (y < 0) ? 0 : (y > 4095) ? 4095 : y;
+		}
+
+		int run = (src[i].count < count - copied) ? src[i].count : count - copied;
+		copied += FillPoints(&dst[copied], &point, run);
+	}
+
+	frame->num_points += count;
+	frame->x_start = glyph->end_x + dx;
+	frame->y_start = glyph->end_y + dy;
+
+	return frame->num_points - 1;
+}
+
+int DrawCachedDigit(Frame* frame, int n, int x, int y)
+{
+	if (n < 0 || n > 9)
+		return frame->num_points - 1;
+
+	return CopyGlyph(frame, n, x, y - 2*size);
+}
+
+int DrawCachedSquare(Frame* frame, int x, int y)
+{
+	int square = size/10;
+
+	return CopyGlyph(frame, GLYPH_COLON, x - square/2, y - square/2);
+}
+
+void CachedSquareStart(int x, int y, int* start_x, int* start_y)
+{
+	int square = size/10;
+
+	*start_x = glyphs[GLYPH_COLON].start_x + x - square/2;
+	*start_y = glyphs[GLYPH_COLON].start_y + y - square/2;
+}
+
+bool AppendCachedDigitStrokes(StrokeList* list, int n, int x, int y)
+{
+	if (n < 0 || n > 9)
+		return true;
+
+	return AppendStrokes(list, &glyph_strokes[n], x, y - 2*size);
+}
+
+bool AppendCachedSquareStrokes(StrokeList* list, int x, int y)
+{
+	int square = size/10;
+
+	return AppendStrokes(list, &glyph_strokes[GLYPH_COLON], x - square/2, y - square/2);
+}
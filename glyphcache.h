@@ -0,0 +1,38 @@
+//Glyph cache.  Each digit and the colon square is traced through DrawLineTo once per
+//(size, color, divider, dwell, hidden_dwell) setting and kept at the origin, run-length encoded
+//(see pointruns.h) since dwell and blank jumps repeat points.  Frames are then assembled by
+//copying, translating and expanding those runs.
+
+#include "main.h"
+#include "pathopt.h"
+
+#pragma once
+
+#define GLYPH_COLON	10	//index of the colon square, after the digits 0-9
+#define NUM_GLYPHS	11
+
+//Rebuilds the cache if any of the render settings changed since the last call.
+//The cache is not locked; only one thread may render from it.
+//Returns 1 if the cache was rebuilt, 0 if it was already current, -1 if out of memory.
+int GlyphCacheUpdate();
+
+//Returns a number that changes every time the cache is rebuilt.
+int GlyphCacheGeneration();
+
+//Appends to the frame the cached digit n with its bottom left corner at (x,y), same placement as DrawDigit.
+//Returns the index of the last point written.
+int DrawCachedDigit(Frame* frame, int n, int x, int y);
+
+//Appends the cached colon square centered on (x,y), same placement as DrawSquare.
+//Returns the index of the last point written.
+int DrawCachedSquare(Frame* frame, int x, int y);
+
+//Returns where the colon square centered on (x,y) starts drawing, after its blank jump.
+void CachedSquareStart(int x, int y, int* start_x, int* start_y);
+
+//Appends the visible strokes of the cached digit n, placed as DrawCachedDigit would draw it.
+//Returns false if the list ran out of room.
+bool AppendCachedDigitStrokes(StrokeList* list, int n, int x, int y);
+
+//Appends the visible strokes of the colon square, placed as DrawCachedSquare would draw it.
+bool AppendCachedSquareStrokes(StrokeList* list, int x, int y);
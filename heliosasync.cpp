@@ -0,0 +1,645 @@
+//Asynchronous USB transport for the Helios DAC, see heliosasync.h
+
+#include "heliosasync.h"
+#include "edgesync.h"
+#include "scheduler.h"
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+
+#define ASYNC_RING		(ASYNC_QUEUE_DEPTH + 1)
+#define CONTROL_TIMEOUT_MS	32	//as HeliosDac uses for the interrupt endpoints
+#define STATUS_REQUEST		0x03
+#define STATUS_RESPONSE		0x83
+
+struct AsyncDevice
+{
+	HeliosAsync* owner;
+	int devNum;
+	struct libusb_device_handle* handle;	//NULL while not connected
+	struct libusb_device* device;		//referenced while connected
+	uint8_t bus;	//where it was last plugged in
+	uint8_t ports[ASYNC_MAX_PORTS];
+	int num_ports;
+	int connections;
+
+	// The status request and its response are submitted together; the frame transfer is only
+	// started once a response says the DAC is ready.
+	struct libusb_transfer* request;
+	struct libusb_transfer* response;
+	struct libusb_transfer* frame;
+	bool request_busy;
+	bool response_busy;
+	bool frame_busy;
+	uint8_t request_bytes[2];
+	uint8_t response_bytes[32];
+	struct timespec next_poll;	//CLOCK_MONOTONIC
+	bool waiting;	//polling for ready since wait_from, polls times so far
+	struct timespec wait_from;	//CLOCK_MONOTONIC
+	int polls;
+	int errors;
+	bool failed;
+	bool repeat;
+	bool checking;	//CheckStatus wants an answer
+
+	// Ring of frames: once has_last is set frames[head] is the last one sent, and the queued
+	// frames follow it.  A frame being sent is never overwritten by QueueFrame.
+	WireFrame frames[ASYNC_RING];
+	uint8_t flags[ASYNC_RING];
+	int head;
+	int queued;
+	bool has_last;
+	uint8_t sent_flags;
+	struct timespec sent_at;	//CLOCK_REALTIME, for the latency measurement
+	struct timespec ready_at;	//CLOCK_MONOTONIC, when the DAC last reported ready
+};
+
+static bool Due(const struct timespec* at, const struct timespec* now)
+{
+	return now->tv_sec > at->tv_sec || (now->tv_sec == at->tv_sec && now->tv_nsec >= at->tv_nsec);
+}
+
+static long MicrosecondsUntil(const struct timespec* at, const struct timespec* now)
+{
+	return (at->tv_sec - now->tv_sec) * 1000000L + (at->tv_nsec - now->tv_nsec) / 1000;
+}
+
+// Sets at to delay_us from now on CLOCK_MONOTONIC.
+static void After(struct timespec* at, long delay_us)
+{
+	clock_gettime(CLOCK_MONOTONIC, at);
+	at->tv_sec += delay_us / 1000000L;
+	at->tv_nsec += (delay_us % 1000000L) * 1000L;
+	if (at->tv_nsec >= 1000000000L) {
+		at->tv_sec++;
+		at->tv_nsec -= 1000000000L;
+	}
+}
+
+static void SchedulePoll(AsyncDevice* dev, long delay_us)
+{
+	After(&dev->next_poll, delay_us);
+}
+
+// Something to send once the DAC is ready; otherwise there is no point polling it.
+static bool HasWork(const AsyncDevice* dev)
+{
+	return !dev->failed && (dev->queued > 0 || (dev->repeat && dev->has_last) || dev->checking);
+}
+
+static bool Busy(const AsyncDevice* dev)
+{
+	return dev->request_busy || dev->response_busy || dev->frame_busy;
+}
+
+// Whether the device is plugged into the port the DAC was last seen on.
+static bool SamePort(const AsyncDevice* dev, struct libusb_device* device)
+{
+	uint8_t ports[ASYNC_MAX_PORTS];
+	int num_ports = libusb_get_port_numbers(device, ports, ASYNC_MAX_PORTS);
+
+	return dev->connections > 0 && libusb_get_bus_number(device) == dev->bus &&
+		num_ports == dev->num_ports && memcmp(ports, dev->ports, num_ports > 0 ? num_ports : 0) == 0;
+}
+
+HeliosAsync::HeliosAsync()
+{
+	context = NULL;
+	numOfDevices = 0;
+	inited = false;
+	watching = false;
+	hotplug_events = false;
+	scan_due = false;
+	for (int i = 0; i < HELIOS_MAX_DEVICES; i++)
+		deviceList[i] = NULL;
+}
+
+HeliosAsync::~HeliosAsync()
+{
+	CloseDevices();
+}
+
+int HeliosAsync::OpenDevices()
+{
+	if (inited)
+		return numOfDevices;
+
+	int result = libusb_init(&context);
+	if (result < 0)
+		return result;
+	inited = true;
+
+	ScanDevices();
+	return numOfDevices;
+}
+
+bool HeliosAsync::WatchDevices()
+{
+	if (!inited) {
+		if (libusb_init(&context) < 0)
+			return false;
+		inited = true;
+	}
+	watching = true;
+
+	// Without hotplug events ScanDevices keeps looking on its own.
+	hotplug_events = libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) &&
+		libusb_hotplug_register_callback(context, (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+			LIBUSB_HOTPLUG_NO_FLAGS, HELIOS_VID, HELIOS_PID, LIBUSB_HOTPLUG_MATCH_ANY, HotplugEvent, this, &hotplug_handle) == LIBUSB_SUCCESS;
+
+	// The first scan runs from HandleEvents, so nothing waits for enumeration here.
+	ScheduleScan(0);
+	return true;
+}
+
+int HeliosAsync::CloseDevices()
+{
+	if (!inited)
+		return 0;
+
+	if (hotplug_events)
+		libusb_hotplug_deregister_callback(context, hotplug_handle);
+	hotplug_events = false;
+	watching = false;
+
+	for (int i = 0; i < numOfDevices; i++)
+		Drop(deviceList[i]);
+
+	// Transfers must have completed, cancelled, before they can be freed.
+	for (int tries = 0; tries < 100; tries++) {
+		bool busy = false;
+		for (int i = 0; i < numOfDevices; i++)
+			busy = busy || Busy(deviceList[i]);
+		if (!busy)
+			break;
+		struct timeval tv = { 0, 10000 };
+		libusb_handle_events_timeout_completed(context, &tv, NULL);
+	}
+
+	for (int i = 0; i < HELIOS_MAX_DEVICES; i++) {
+		AsyncDevice* dev = deviceList[i];
+		if (dev == NULL)
+			continue;
+		if (dev->handle != NULL)
+			Detach(dev);
+		libusb_free_transfer(dev->request);
+		libusb_free_transfer(dev->response);
+		libusb_free_transfer(dev->frame);
+		delete dev;
+		deviceList[i] = NULL;
+	}
+
+	libusb_exit(context);
+	context = NULL;
+	numOfDevices = 0;
+	inited = false;
+	return 0;
+}
+
+//Returns the next unused device, with its transfers, or NULL if there is no room.  It only counts
+//in numOfDevices once a DAC is attached to it.
+AsyncDevice* HeliosAsync::NewDevice()
+{
+	if (numOfDevices >= HELIOS_MAX_DEVICES)
+		return NULL;
+	if (deviceList[numOfDevices] != NULL)
+		return deviceList[numOfDevices];
+
+	AsyncDevice* dev = new AsyncDevice();
+	dev->owner = this;
+	dev->devNum = numOfDevices;
+	dev->failed = true;
+	dev->request = libusb_alloc_transfer(0);
+	dev->response = libusb_alloc_transfer(0);
+	dev->frame = libusb_alloc_transfer(0);
+	if (dev->request == NULL || dev->response == NULL || dev->frame == NULL) {
+		libusb_free_transfer(dev->request);
+		libusb_free_transfer(dev->response);
+		libusb_free_transfer(dev->frame);
+		delete dev;
+		return NULL;
+	}
+
+	deviceList[numOfDevices] = dev;
+	return dev;
+}
+
+//Opens the DAC on device into dev, which starts out with nothing queued.
+bool HeliosAsync::Attach(AsyncDevice* dev, struct libusb_device* device)
+{
+	libusb_device_handle* handle;
+	if (libusb_open(device, &handle) < 0)
+		return false;
+	if (libusb_claim_interface(handle, 0) < 0 || libusb_set_interface_alt_setting(handle, 0, 1) < 0) {
+		libusb_close(handle);
+		return false;
+	}
+
+	dev->handle = handle;
+	dev->device = libusb_ref_device(device);
+	dev->bus = libusb_get_bus_number(device);
+	dev->num_ports = libusb_get_port_numbers(device, dev->ports, ASYNC_MAX_PORTS);
+	dev->connections++;
+
+	dev->head = 0;
+	dev->queued = 0;
+	dev->has_last = false;
+	dev->waiting = false;
+	dev->errors = 0;
+	dev->failed = false;
+	dev->checking = false;
+	SchedulePoll(dev, 0);
+
+	// Drop any status response left over from an earlier session.
+	int transferred;
+	libusb_interrupt_transfer(handle, EP_INT_IN, dev->response_bytes, sizeof(dev->response_bytes), &transferred, 5);
+	return true;
+}
+
+//Closes a failed DAC.  Its transfers must have completed.
+void HeliosAsync::Detach(AsyncDevice* dev)
+{
+	libusb_release_interface(dev->handle, 0);
+	libusb_close(dev->handle);
+	libusb_unref_device(dev->device);
+	dev->handle = NULL;
+	dev->device = NULL;
+	dev->failed = true;
+}
+
+//Gives up on a DAC, cancelling whatever it has in flight.
+void HeliosAsync::Drop(AsyncDevice* dev)
+{
+	dev->failed = true;
+	if (dev->request_busy) libusb_cancel_transfer(dev->request);
+	if (dev->response_busy) libusb_cancel_transfer(dev->response);
+	if (dev->frame_busy) libusb_cancel_transfer(dev->frame);
+}
+
+//Opens every Helios DAC that is plugged in and not open yet.
+void HeliosAsync::ScanDevices()
+{
+	scan_due = false;
+
+	libusb_device** devs;
+	ssize_t cnt = libusb_get_device_list(context, &devs);
+	if (cnt < 0) {
+		if (watching)
+			ScheduleScan(ASYNC_RESCAN_MS * 1000L);
+		return;
+	}
+
+	bool retry = false;
+	for (ssize_t i = 0; i < cnt; i++) {
+		struct libusb_device_descriptor devDesc;
+		if (libusb_get_device_descriptor(devs[i], &devDesc) < 0)
+			continue;
+		if (devDesc.idVendor != HELIOS_VID || devDesc.idProduct != HELIOS_PID)
+			continue;
+
+		AsyncDevice* dev = NULL;
+		bool open = false;
+		for (int n = 0; n < numOfDevices; n++)
+			open = open || (deviceList[n]->handle != NULL && deviceList[n]->device == devs[i]);
+		if (open)
+			continue;
+
+		// Back under the number it had on this port, else a new number, else any that is free.
+		for (int n = 0; n < numOfDevices && dev == NULL; n++) {
+			if (deviceList[n]->handle == NULL && SamePort(deviceList[n], devs[i]))
+				dev = deviceList[n];
+		}
+		bool added = false;
+		if (dev == NULL) {
+			dev = NewDevice();
+			added = dev != NULL;
+		}
+		for (int n = 0; n < numOfDevices && dev == NULL; n++) {
+			if (deviceList[n]->handle == NULL)
+				dev = deviceList[n];
+		}
+		if (dev == NULL)
+			continue;
+
+		if (!Attach(dev, devs[i])) {
+			retry = true;
+			continue;
+		}
+		if (added)
+			numOfDevices++;
+		if (watching)
+			fprintf(stderr, "DAC %d connected..\n", dev->devNum);
+	}
+	libusb_free_device_list(devs, 1);
+
+	if (watching && (retry || !hotplug_events))
+		ScheduleScan(ASYNC_RESCAN_MS * 1000L);
+}
+
+//Makes sure a scan is due within delay_us.
+void HeliosAsync::ScheduleScan(long delay_us)
+{
+	struct timespec at;
+
+	After(&at, delay_us);
+	if (!scan_due || !Due(&next_scan, &at)) {
+		next_scan = at;
+		scan_due = true;
+	}
+}
+
+int LIBUSB_CALL HeliosAsync::HotplugEvent(struct libusb_context*, struct libusb_device* device, libusb_hotplug_event event, void* user_data)
+{
+	HeliosAsync* usb = (HeliosAsync*)user_data;
+
+	// Opened from HandleEvents, once the callbacks are done.
+	if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+		usb->ScheduleScan(0);
+		return 0;
+	}
+
+	for (int i = 0; i < usb->numOfDevices; i++) {
+		AsyncDevice* dev = usb->deviceList[i];
+		if (dev->handle != NULL && dev->device == device && !dev->failed) {
+			fprintf(stderr, "DAC %d unplugged..\n", i);
+			usb->Drop(dev);
+		}
+	}
+	return 0;
+}
+
+int HeliosAsync::QueueFrame(int devNum, const WireFrame* wire, uint8_t flags)
+{
+	if (devNum < 0 || devNum >= numOfDevices || wire->size == 0)
+		return 0;
+
+	AsyncDevice* dev = deviceList[devNum];
+	int kept = dev->queued + (dev->has_last ? 1 : 0);
+	if (dev->failed || kept >= ASYNC_RING)
+		return 0;
+
+	// Copy only the bytes that are sent, not the whole staging buffer.
+	int slot = (dev->head + kept) % ASYNC_RING;
+	memcpy(dev->frames[slot].bytes, wire->bytes, wire->size);
+	dev->frames[slot].num_points = wire->num_points;
+	dev->frames[slot].size = wire->size;
+	dev->frames[slot].part = wire->part;
+	dev->flags[slot] = flags;
+	dev->queued++;
+	return 1;
+}
+
+int HeliosAsync::QueuedFrames(int devNum)
+{
+	if (devNum < 0 || devNum >= numOfDevices)
+		return 0;
+	return deviceList[devNum]->queued;
+}
+
+void HeliosAsync::SetRepeat(int devNum, bool repeat)
+{
+	if (devNum >= 0 && devNum < numOfDevices)
+		deviceList[devNum]->repeat = repeat;
+}
+
+void HeliosAsync::CheckStatus(int devNum)
+{
+	if (devNum >= 0 && devNum < numOfDevices && !deviceList[devNum]->failed)
+		deviceList[devNum]->checking = true;
+}
+
+bool HeliosAsync::Failed(int devNum)
+{
+	if (devNum < 0 || devNum >= numOfDevices)
+		return true;
+	return deviceList[devNum]->failed;
+}
+
+int HeliosAsync::Connections(int devNum)
+{
+	if (devNum < 0 || devNum >= numOfDevices)
+		return 0;
+	return deviceList[devNum]->connections;
+}
+
+int HeliosAsync::HandleEvents(int timeout_us)
+{
+	if (!inited)
+		return 0;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (watching) {
+		// A failed DAC is closed once nothing is in flight, and looked for again shortly after.
+		for (int i = 0; i < numOfDevices; i++) {
+			AsyncDevice* dev = deviceList[i];
+			if (dev->handle != NULL && dev->failed && !Busy(dev)) {
+				Detach(dev);
+				ScheduleScan(ASYNC_REOPEN_MS * 1000L);
+			}
+		}
+		if (scan_due && Due(&next_scan, &now))
+			ScanDevices();
+	}
+
+	long wait_us = timeout_us;
+	if (watching && scan_due && MicrosecondsUntil(&next_scan, &now) < wait_us)
+		wait_us = MicrosecondsUntil(&next_scan, &now);
+	for (int i = 0; i < numOfDevices; i++) {
+		AsyncDevice* dev = deviceList[i];
+		if (!HasWork(dev) || Busy(dev))
+			continue;
+
+		if (Due(&dev->next_poll, &now)) {
+			StartPoll(dev);
+		} else {
+			long until = MicrosecondsUntil(&dev->next_poll, &now);
+			if (until < wait_us)
+				wait_us = until;
+		}
+	}
+	if (wait_us < 0)
+		wait_us = 0;
+
+	struct timeval tv;
+	tv.tv_sec = wait_us / 1000000L;
+	tv.tv_usec = wait_us % 1000000L;
+	int result = libusb_handle_events_timeout_completed(context, &tv, NULL);
+	return result == 0 || result == LIBUSB_ERROR_INTERRUPTED;
+}
+
+void HeliosAsync::StartPoll(AsyncDevice* dev)
+{
+	if (!HasWork(dev) || Busy(dev))
+		return;
+
+	// The response is submitted alongside the request, so it is collected as soon as the DAC
+	// answers instead of after a second round trip through this thread.
+	if (!dev->waiting) {
+		clock_gettime(CLOCK_MONOTONIC, &dev->wait_from);
+		dev->waiting = true;
+		dev->polls = 0;
+	}
+	dev->polls++;
+
+	dev->request_bytes[0] = STATUS_REQUEST;
+	dev->request_bytes[1] = 0;
+	libusb_fill_interrupt_transfer(dev->request, dev->handle, EP_INT_OUT, dev->request_bytes, sizeof(dev->request_bytes), StatusRequestDone, dev, CONTROL_TIMEOUT_MS);
+	libusb_fill_interrupt_transfer(dev->response, dev->handle, EP_INT_IN, dev->response_bytes, sizeof(dev->response_bytes), StatusResponseDone, dev, CONTROL_TIMEOUT_MS);
+
+	int result = libusb_submit_transfer(dev->response);
+	if (result < 0) {
+		TransferFailed(dev, result);
+		return;
+	}
+	dev->response_busy = true;
+
+	result = libusb_submit_transfer(dev->request);
+	if (result < 0) {
+		libusb_cancel_transfer(dev->response);
+		TransferFailed(dev, result);
+		return;
+	}
+	dev->request_busy = true;
+}
+
+void HeliosAsync::StartFrame(AsyncDevice* dev)
+{
+	if (dev->failed || dev->frame_busy)
+		return;
+
+	if (dev->queued > 0) {
+		if (dev->has_last)
+			dev->head = (dev->head + 1) % ASYNC_RING;
+		dev->has_last = true;
+		dev->queued--;
+		dev->sent_flags = dev->flags[dev->head];
+	} else if (dev->repeat && dev->has_last) {
+		dev->sent_flags = 0;
+	} else {
+		return;
+	}
+
+	WireFrame* wire = &dev->frames[dev->head];
+	wire->bytes[wire->size - 1] = dev->sent_flags;
+	libusb_fill_bulk_transfer(dev->frame, dev->handle, EP_BULK_OUT, wire->bytes, wire->size, FrameDone, dev, 8 + (wire->size >> 5));
+
+	StatsReadyToSubmit(dev->devNum, &dev->ready_at);
+	clock_gettime(CLOCK_REALTIME, &dev->sent_at);
+	int result = libusb_submit_transfer(dev->frame);
+	if (result < 0) {
+		StatsFrameSent(dev->devNum, NULL, 0, false);
+		TransferFailed(dev, result);
+		return;
+	}
+	dev->frame_busy = true;
+}
+
+void HeliosAsync::TransferFailed(AsyncDevice* dev, int status)
+{
+	if (dev->failed)
+		return;
+
+	if (dev->checking) {
+		StatsKeepalive(dev->devNum, false);
+		dev->checking = false;
+	}
+
+	// Back off before the next poll, and give up on a DAC that keeps failing.
+	SchedulePoll(dev, poll_us);
+
+	if (++dev->errors >= ASYNC_MAX_ERRORS) {
+		fprintf(stderr, "DAC %d stopped responding (%s)%s..\n", dev->devNum, libusb_error_name(status), watching ? ", reconnecting" : "");
+		Drop(dev);
+	}
+}
+
+// Maps a transfer completion status onto the libusb error codes, for reporting.
+static int TransferError(enum libusb_transfer_status status)
+{
+	switch (status) {
+	case LIBUSB_TRANSFER_TIMED_OUT: return LIBUSB_ERROR_TIMEOUT;
+	case LIBUSB_TRANSFER_STALL: return LIBUSB_ERROR_PIPE;
+	case LIBUSB_TRANSFER_NO_DEVICE: return LIBUSB_ERROR_NO_DEVICE;
+	case LIBUSB_TRANSFER_OVERFLOW: return LIBUSB_ERROR_OVERFLOW;
+	default: return LIBUSB_ERROR_IO;
+	}
+}
+
+void LIBUSB_CALL HeliosAsync::StatusRequestDone(struct libusb_transfer* transfer)
+{
+	AsyncDevice* dev = (AsyncDevice*)transfer->user_data;
+
+	dev->request_busy = false;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED && transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+		// Without the request there is no response coming.
+		if (dev->response_busy)
+			libusb_cancel_transfer(dev->response);
+		dev->owner->TransferFailed(dev, TransferError(transfer->status));
+	}
+}
+
+void LIBUSB_CALL HeliosAsync::StatusResponseDone(struct libusb_transfer* transfer)
+{
+	AsyncDevice* dev = (AsyncDevice*)transfer->user_data;
+
+	dev->response_busy = false;
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+		return;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED || transfer->actual_length < 2 || dev->response_bytes[0] != STATUS_RESPONSE) {
+		dev->owner->TransferFailed(dev, TransferError(transfer->status));
+		return;
+	}
+
+	dev->errors = 0;
+	if (dev->checking) {
+		StatsKeepalive(dev->devNum, true);
+		dev->checking = false;
+	}
+	if (dev->response_bytes[1] != 0) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		StatsDacPoll(dev->devNum, dev->polls, (now.tv_sec - dev->wait_from.tv_sec) * 1000000000L + (now.tv_nsec - dev->wait_from.tv_nsec));
+		dev->ready_at = now;
+		dev->waiting = false;
+		dev->owner->StartFrame(dev);
+		return;
+	}
+
+	// Not ready yet: poll again straight away when spinning, after the poll interval otherwise.
+	if (sched_mode == SCHED_SLEEP) {
+		SchedulePoll(dev, poll_us);
+	} else {
+		SchedulePoll(dev, 0);
+		dev->owner->StartPoll(dev);
+	}
+}
+
+void LIBUSB_CALL HeliosAsync::FrameDone(struct libusb_transfer* transfer)
+{
+	AsyncDevice* dev = (AsyncDevice*)transfer->user_data;
+
+	dev->frame_busy = false;
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+		return;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		StatsFrameSent(dev->devNum, NULL, 0, false);
+		dev->owner->TransferFailed(dev, TransferError(transfer->status));
+		return;
+	}
+
+	struct timespec end;
+	clock_gettime(CLOCK_REALTIME, &end);
+	long elapsed = (end.tv_sec - dev->sent_at.tv_sec) * 1000000000L + (end.tv_nsec - dev->sent_at.tv_nsec);
+
+	dev->errors = 0;
+	StatsFrameSent(dev->devNum, &dev->frames[dev->head], elapsed, true);
+	if (dev->sent_flags & HELIOS_FLAGS_START_IMMEDIATELY)
+		RecordOutputLatency(elapsed);
+
+	// A status poll started while the frame was still in flight could be answered before the
+	// DAC has taken it, so the next poll only goes out now, from the completion itself.
+	SchedulePoll(dev, 0);
+	dev->owner->StartPoll(dev);
+}
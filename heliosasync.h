@@ -0,0 +1,97 @@
+//Asynchronous USB transport for the Helios DAC.  HeliosDac::SendFrame and GetControlResponse
+//block the caller for every transfer, so each DAC needs its own thread and every frame waits
+//for a full stop-and-wait status poll.  HeliosAsync opens the DACs itself and drives them with
+//libusb_submit_transfer: each DAC keeps its status request and response in flight together,
+//a small queue of packed frames waits behind the one playing, and the next frame goes out
+//from the completion callback the moment the DAC reports ready.  One thread calling
+//HandleEvents keeps any number of DACs fed.
+//
+//With WatchDevices the DACs are also opened from HandleEvents as they are plugged in, found
+//through libusb hotplug events (or a periodic rescan where libusb has none), and a DAC that
+//fails or is unplugged is closed and opened again once it is back.  Each DAC keeps its number
+//by the USB port it is plugged into, so a reconnected DAC keeps its -dac_offset.
+//
+//Not thread safe: call everything from the thread that runs HandleEvents.
+
+#include "main.h"
+#include "wireframe.h"
+#include <time.h>
+
+#pragma once
+
+#define ASYNC_QUEUE_DEPTH	3	//frames that can wait behind the last one sent, per DAC
+#define ASYNC_MAX_ERRORS	5	//consecutive failed transfers before a DAC is given up on
+#define ASYNC_MAX_PORTS		7	//depth of the USB port path kept to recognise a DAC
+#define ASYNC_REOPEN_MS		250	//before reopening a DAC that failed
+#define ASYNC_RESCAN_MS		1000	//between scans for DACs, without hotplug events
+
+struct AsyncDevice;
+
+class HeliosAsync
+{
+public:
+
+	HeliosAsync();
+	~HeliosAsync();
+
+	//Opens connection to all devices.  Returns number of available devices, as
+	//HeliosDacClass::OpenDevices does.  Do not open the same DACs through HeliosDacClass too.
+	int OpenDevices();
+	int CloseDevices();
+
+	//Watches for DACs instead of opening them now: HandleEvents opens each one as it appears and
+	//reopens any that fail.  Returns false if libusb could not be initialised.
+	bool WatchDevices();
+
+	//Queues a committed frame, copied, to be sent with the given flags as soon as the DAC is
+	//ready.  Returns 1 if queued, 0 if the queue is full or the DAC has failed.
+	int QueueFrame(int devNum, const WireFrame* wire, uint8_t flags);
+
+	//Frames queued for the DAC and not yet sent.
+	int QueuedFrames(int devNum);
+
+	//While on, the last frame sent goes out again, with no flags, whenever the DAC is ready and
+	//nothing is queued.  Off by default.
+	void SetRepeat(int devNum, bool repeat);
+
+	//Sends the DAC a status request even with nothing to send, to confirm it still answers.  A
+	//DAC that does not counts a failed transfer, as for any other.
+	void CheckStatus(int devNum);
+
+	//Returns true once the DAC has stopped answering, or while it is not connected.
+	bool Failed(int devNum);
+
+	//Times the DAC has been opened.  A change means it reconnected, with nothing queued.
+	int Connections(int devNum);
+
+	//Starts the status polls that are due and handles transfer completions, waiting up to
+	//timeout_us for one.  Returns 0 if libusb event handling failed.
+	int HandleEvents(int timeout_us);
+
+	int numOfDevices;
+
+private:
+
+	AsyncDevice* NewDevice();
+	bool Attach(AsyncDevice* dev, struct libusb_device* device);
+	void Detach(AsyncDevice* dev);
+	void Drop(AsyncDevice* dev);
+	void ScanDevices();
+	void ScheduleScan(long delay_us);
+	void StartPoll(AsyncDevice* dev);
+	void StartFrame(AsyncDevice* dev);
+	void TransferFailed(AsyncDevice* dev, int status);
+	static void LIBUSB_CALL StatusRequestDone(struct libusb_transfer* transfer);
+	static void LIBUSB_CALL StatusResponseDone(struct libusb_transfer* transfer);
+	static void LIBUSB_CALL FrameDone(struct libusb_transfer* transfer);
+	static int LIBUSB_CALL HotplugEvent(struct libusb_context* ctx, struct libusb_device* device, libusb_hotplug_event event, void* user_data);
+
+	struct libusb_context* context;
+	AsyncDevice* deviceList[HELIOS_MAX_DEVICES];
+	bool inited;
+	bool watching;
+	bool hotplug_events;	//libusb reports arrivals, no periodic rescan needed
+	libusb_hotplug_callback_handle hotplug_handle;
+	bool scan_due;		//look for new DACs from next_scan on
+	struct timespec next_scan;	//CLOCK_MONOTONIC
+};
@@ -6,10 +6,88 @@
 	Last Updated: January 28, 2017
 	
 	Build instructions:
-	g++ -L. -Wall -o laserclock laserclock.cpp -lHeliosDacAPI
+	g++ -L. -Wall -o laserclock laserclock.cpp glyphcache.cpp clockframe.cpp linekernel.cpp motion.cpp pathopt.cpp pointbudget.cpp renderthread.cpp scheduler.cpp edgesync.cpp dacoutput.cpp wireframe.cpp heliosasync.cpp stats.cpp strokefont.cpp curves.cpp pointarena.cpp pointruns.cpp framesink.cpp framecache.cpp netcontent.cpp compositor.cpp correction.cpp rtmode.cpp -lHeliosDacAPI -lusb-1.0 -lpthread
+
+	Add -O2 for an optimized build.  On a Raspberry Pi 2/3 also add -mfpu=neon so the line kernel uses NEON.
+
+	To measure render performance offline, without a Helios DAC attached, build the benchmark:
+	g++ -O2 -Wall -DLASERCLOCK_BENCH -o laserbench bench.cpp mockdac.cpp laserclock.cpp glyphcache.cpp clockframe.cpp linekernel.cpp motion.cpp pathopt.cpp pointbudget.cpp renderthread.cpp compositor.cpp wireframe.cpp stats.cpp strokefont.cpp curves.cpp pointarena.cpp pointruns.cpp -lpthread
+	./laserbench -sizes 150,250,350 -dividers 25,50,100 -dwells 5,10,20
 
 	Example program execution:
 	sudo ./laserclock -size 350 -xpos 0 -ypos 2000 -color 1
+
+	To leave the CPU idle between DAC polls instead of busy-spinning:
+	sudo ./laserclock -size 350 -sched sleep -poll_us 1000
+
+	To reorder strokes across the frame for the shortest blanked travel:
+	sudo ./laserclock -size 350 -optimize_path 1
+
+	To place points by a galvo motion model (speed in DAC units per point, acceleration in units
+	per point per point) instead of the uniform divider, with the dwell scaled by corner angle
+	and jump distance:
+	sudo ./laserclock -size 350 -motion 1 -scan_speed 100 -scan_accel 20
+
+	To let divider and dwell follow the point budget for a 30 fps refresh instead of hand-tuning them:
+	sudo ./laserclock -size 350 -auto_budget 1 -target_fps 30
+
+	To play every frame at the point rate that refreshes it 30 times a second, whatever the time
+	shows, up to 30K points per second:
+	sudo ./laserclock -size 350 -adapt_pps 1 -target_fps 30 -max_pps 30000
+
+	To render each second's frame ahead of time on a separate thread:
+	sudo ./laserclock -size 350 -render_ahead 1
+
+	To change the displayed time on the true second edge, compensating for the measured
+	(or, with -latency_us, a fixed) delay from WriteFrame to light:
+	sudo ./laserclock -size 350 -render_ahead 1 -edge_sync 1
+
+	To drive every connected DAC, each fed by its own thread, with DAC 1 shifted 200 units right:
+	sudo ./laserclock -size 300 -multi_dac 1 -dac_offset 1 200 0
+
+	To drive the DACs with asynchronous USB transfers, all fed from a single thread:
+	sudo ./laserclock -size 300 -multi_dac 1 -usb_async 1
+
+	To correct keystone by moving the corners of the picture to where they should land, and
+	pull in pincushion distortion, on every DAC (see correction.h):
+	sudo ./laserclock -size 350 -corners 200,0,3895,0,4095,4095,0,4095 -pincushion 0.05
+
+	To send each frame only once, when the time changes, and let the DACs loop it, which leaves
+	the USB bus free for other DACs on the same hub:
+	sudo ./laserclock -size 300 -multi_dac 1 -send_on_change 1
+
+	To start drawing at once and pick up DACs as they are plugged in, reopening any that drop off
+	USB without a restart:
+	sudo ./laserclock -size 300 -multi_dac 1 -hotplug 1
+
+	To render all 86400 frames of the day once into a memory mapped file and play them from there,
+	re-rendered automatically whenever the settings change:
+	sudo ./laserclock -size 350 -frame_cache /var/cache/laserclock.frames
+
+	To write every frame to an ILDA file as well, or to stream the frames in a compact binary
+	format to stdout or a TCP connection (see framesink.h), with or without a DAC attached:
+	sudo ./laserclock -size 350 -ilda_file clock.ild
+	./laserclock -size 350 -stream showcontrol.local:7255
+
+	To pre-generate an hour of the clock from now as an ILDA file, as fast as it renders:
+	./laserclock -size 350 -ilda_file hour.ild -sink_seconds 3600
+
+	To show text or countdowns pushed over UDP to every clock in a multicast group (see netcontent.h),
+	with the wall clock shown until the first update:
+	sudo ./laserclock -size 350 -udp_port 7256 -udp_group 239.0.0.1
+
+	To show the date and the temperature under the clock as zones of their own (see compositor.h),
+	the temperature limited to 200 points and coarsened before the date when the frame is full:
+	sudo ./laserclock -size 300 -ypos 2600 -date_zone 0,1500,120 -temp_zone 2500,1500,120,200,0
+
+	To feed the DACs from real-time priority threads pinned to CPU 3, with memory locked, and
+	print how long frames wait between the DAC reporting ready and being submitted every minute
+	(see rtmode.h):
+	sudo ./laserclock -size 350 -rt_priority 80 -rt_cpu 3 -jitter_interval 60
+
+	To write frame rate, poll, latency and late frame counters every 10 seconds, in the
+	Prometheus text format, for monitoring to scrape:
+	sudo ./laserclock -size 350 -stats_file /var/lib/node_exporter/laserclock.prom -stats_interval 10
 	
 	Notes:  I used a galvanometer rated for 30K points per second.  At 30K, the projector can
 	display approximately 1000 points per vector_list, at 30 vector_lists per second.  This vector_listrate looks reasonable
@@ -33,6 +111,25 @@
 */
 
 #include "main.h"
+#include "clockframe.h"
+#include "pointbudget.h"
+#include "renderthread.h"
+#include "pathopt.h"
+#include "linekernel.h"
+#include "motion.h"
+#include "scheduler.h"
+#include "edgesync.h"
+#include "dacoutput.h"
+#include "framesink.h"
+#include "framecache.h"
+#include "netcontent.h"
+#include "compositor.h"
+#include "correction.h"
+#include "rtmode.h"
+#include "stats.h"
+#include "strokefont.h"
+#include "curves.h"
+#include "pointarena.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -40,15 +137,6 @@
 #include <math.h>
 #include <unistd.h>
 
-#define MAX_POINTS 10000
-#define MAX_PTS_FRAME 1000
-#define POINTS_PER_SECOND 30000
-
-HeliosDacClass::HeliosPoint vector_list[MAX_POINTS];
-int num_points = 0;
-int x_start = 0;
-int y_start = 0;
-
 // The left most x coordinate to start drawing the image.
 int xpos = 0;
 
@@ -69,6 +157,7 @@ int color = 1;
 // If too low, there are too many points to display.
 // If too high, the image will flicker because there are too many points to display per frame, so the frame rate drops.
 // If you adjust the size of the display, you may need to alter this divider accordingly.
+// The geometry can instead be corrected directly (see correction.h), which lets it be raised.
 float divider = 50.0; 
 
 // dwell used for visible lines
@@ -79,260 +168,277 @@ int dwell = 10;
 // Experimental value
 int hidden_dwell = 15; 
 
-int DrawPoint(int x, int y, int color)
+// RGB for each color number, 0 is blank.  Numbers past the end of the table draw white.
+#define NUM_COLORS 8
+static const unsigned char palette[NUM_COLORS][3] = {
+	{   0,   0,   0 },
+	{ 255,   0,   0 },
+	{   0, 255,   0 },
+	{   0,   0, 255 },
+	{ 255, 255,   0 },
+	{ 255,   0, 255 },
+	{   0, 255, 255 },
+	{ 255, 255, 255 },
+};
+
+HeliosDacClass::HeliosPoint PalettePoint(int color)
 {
-	unsigned short r, g, b;
+	HeliosDacClass::HeliosPoint point;
+	const unsigned char* rgb = (color >= 0 && color < NUM_COLORS) ? palette[color] : palette[NUM_COLORS - 1];
+
+	point.x = 0;
+	point.y = 0;
+	point.r = rgb[0];
+	point.g = rgb[1];
+	point.b = rgb[2];
+	point.i = 0xFF;
+	return point;
+}
 
-	if (num_points >= MAX_POINTS)
-		return 0;
+// Clipping is counted as frames are drawn and reported once per frame by ReportClipping.
+static int clipped_x = 0;
+static int clipped_y = 0;
 
-	// Perform clipping.  Reduce the digit size if clipping occurs.
+void NoteClipping(bool x, bool y)
+{
+	if (x) clipped_x++;
+	if (y) clipped_y++;
+}
 
-	if (x > 4095) {
-		fprintf(stderr, "Clipping!  Reduce size and/or adjust x position..\n");
-		x = 4095;
+void ReportClipping()
+{
+	static time_t last_report = 0;
+	static int last_x = 0;
+	static int last_y = 0;
+
+	if (clipped_x == 0 && clipped_y == 0)
+		return;
+
+	// The same numbers every second are only repeated every CLIP_REPORT_INTERVAL seconds.
+	time_t now = time(NULL);
+	if (clipped_x != last_x || clipped_y != last_y || now - last_report >= CLIP_REPORT_INTERVAL) {
+		if (clipped_x)
+			fprintf(stderr, "Clipping!  %d shapes outside x range this frame.  Reduce size and/or adjust x position..\n", clipped_x);
+		if (clipped_y)
+			fprintf(stderr, "Clipping!  %d shapes outside y range this frame.  Reduce size and/or adjust y position..\n", clipped_y);
+		last_report = now;
+		last_x = clipped_x;
+		last_y = clipped_y;
 	}
 
-	if (x < 0) x = 0;
+	clipped_x = 0;
+	clipped_y = 0;
+}
 
-	if (y > 4095) {
-		fprintf(stderr, "Clipping!  Reduce size and/or adjust y position..\n");
-		y = 4095;
+bool InitFrame(Frame* frame)
+{
+	if (frame->points == NULL) {
+		frame->points = ArenaAllocPoints();
+		if (frame->points == NULL)
+			return false;
+		frame->capacity = MAX_POINTS;
 	}
+	ClearFrame(frame);
+	return true;
+}
 
-	if (y < 0) y = 0;
+void ReleaseFrame(Frame* frame)
+{
+	ArenaFreePoints(frame->points);
+	frame->points = NULL;
+	frame->capacity = 0;
+	ClearFrame(frame);
+}
 
-	switch (color) {
-		case 0:
-			r = 0;
-			g = 0;
-			b = 0;
-			break;
-		case 1:
-			r = 255;
-			g = 0;
-			b = 0;
-			break;
-		case 2:
-			r = 0;
-			g = 255;
-			b = 0;
-			break;
-		case 3:
-			r = 0;
-			g = 0;
-			b = 255;
-			break;
-		case 4:
-			r = 255;
-			g = 255;
-			b = 0;
-			break;
-		case 5:
-			r = 255;
-			g = 0;
-			b = 255;
-			break;
-		case 6:
-			r = 0;
-			g = 255;
-			b = 255;
-			break;
-		case 7:
-			r = 255;
-			g = 255;
-			b = 255;
-			break;
-		default:
-			r = 255;
-			g = 255;
-			b = 255;
-			break;	
-	}
+void ClearFrame(Frame* frame)
+{
+	frame->num_points = 0;
+	frame->overflow = false;
+	frame->x_start = 0;
+	frame->y_start = 0;
+	frame->recorder = NULL;
+	frame->tail_end = -1;
+	frame->tail_dwell = 0;
+	frame->runs = NULL;
+	frame->num_runs = 0;
+	frame->pps = POINTS_PER_SECOND;
+	frame->brightness = FULL_BRIGHTNESS;
+}
 
-	vector_list[num_points].x = x;
-	vector_list[num_points].y = y;
-	vector_list[num_points].r = r;
-	vector_list[num_points].g = g;
-	vector_list[num_points].b = b;
-	vector_list[num_points].i = 0xFF;
+void TruncateFrame(Frame* frame, int num_points)
+{
+	if (num_points < frame->num_points)
+		frame->num_points = num_points;
 
-	return num_points ++;
+	// Whatever was dropped came after a frame that is not full yet.
+	frame->overflow = frame->overflow && frame->num_points >= frame->capacity;
+	frame->tail_end = -1;
 }
 
+int FrameRoom(Frame* frame, int count)
+{
+	int room = frame->capacity - frame->num_points;
+
+	if (count <= room)
+		return count;
+	frame->overflow = true;
+	return (room > 0) ? room : 0;
+}
 
-int DrawLineTo(int x, int y, int color)
+int DrawPoint(Frame* frame, int x, int y, int color)
 {
+	if (FrameRoom(frame, 1) == 0)
+		return 0;
 
-	int i;
-	int status = 0;
-	float x_length = x - x_start;
-	float y_length = y - y_start;
-	float vector_length = sqrtf((x_length * x_length) + (y_length * y_length));
+	// Perform clipping.  Reduce the digit size if clipping occurs.
+	NoteClipping(x > 4095, y > 4095);
+
+	if (x > 4095) x = 4095;
+	if (x < 0) x = 0;
+	if (y > 4095) y = 4095;
+	if (y < 0) y = 0;
+
+	frame->points[frame->num_points] = PalettePoint(color);
+	frame->points[frame->num_points].x = x;
+	frame->points[frame->num_points].y = y;
+
+	return frame->num_points ++;
+}
+
+// DrawLineTo with -motion.  Every visible line ends at rest with the full dwell, which the next
+// visible line from the same vertex cuts back to what its turn angle needs.
+static int MotionLineTo(Frame* frame, int x, int y, int color, HeliosDacClass::HeliosPoint* point)
+{
+	int x0 = frame->x_start;
+	int y0 = frame->y_start;
+	int count;
 
-	// Interpolate from the previous point (x_start, y_start) to the new point (x,y).
-	int num_segments = ceilf(vector_length/divider);
-	
 	if (color > 0) {
-		for (i=1; i <= num_segments; i++) {
-			status = DrawPoint(x_start + (x_length/(float)num_segments) * i, 
-					y_start + (y_length/(float)num_segments) * i, 
-					color);
+		float x_length = x - x0;
+		float y_length = y - y0;
+		float vector_length = sqrtf((x_length * x_length) + (y_length * y_length));
+
+		if (vector_length > 0) {
+			float ux = x_length / vector_length;
+			float uy = y_length / vector_length;
+			if (frame->tail_end == frame->num_points && frame->tail_dwell > 0) {
+				int keep = MotionCornerDwell(frame->tail_dx, frame->tail_dy, ux, uy);
+				if (keep < frame->tail_dwell)
+					frame->num_points -= frame->tail_dwell - keep;
+			}
+
+			int room = frame->capacity - frame->num_points;
+			int needed = MotionLinePoints(&frame->points[frame->num_points], x0, y0, x, y, room, point);
+			frame->num_points += FrameRoom(frame, needed);
+			frame->tail_dx = ux;
+			frame->tail_dy = uy;
 		}
-	} 
-
-	// dwell at the end point, one duration for hidden vectors, 
-	// another duration for visible vectors
-	if (color == 0) {
-		for (i = 0; i < hidden_dwell; i++)
-			status = DrawPoint(x,y,color);
+		count = dwell;
 	} else {
-		for (i = 0; i < dwell; i++)
-			status = DrawPoint(x,y,color);
+		count = MotionJumpDwell(x0, y0, x, y);
 	}
 
+	count = FrameRoom(frame, count);
 
-	x_start = x;
-	y_start = y;
-	
-	return status;
-}
+	point->x = (x < 0) ? 0 : (x > 4095) ? 4095 : x;
+	point->y = (y < 0) ? 0 : (y > 4095) ? 4095 : y;
+	frame->num_points += FillPoints(&frame->points[frame->num_points], point, count);
 
-void DrawZero(int x, int y, int color, int size)
-{
-	DrawLineTo(x, y, 0);
-	DrawLineTo(x + size, y, color);
-	DrawLineTo(x + size, y - 2* size, color);
-	DrawLineTo(x, y - 2*size, color);
-	DrawLineTo(x, y, color);
-}
-void DrawOne(int x, int y, int color, int size)
-{
-	DrawLineTo(x + size, y, 0); // An added dwell here helps sharpen the digit.
-	DrawLineTo(x + size, y, 0);
-	DrawLineTo(x + size, y - 2 * size, color);
+	frame->tail_dwell = (color > 0) ? count : 0;
+	frame->tail_end = frame->num_points;
+	frame->x_start = x;
+	frame->y_start = y;
+
+	return frame->num_points - 1;
 }
-void DrawTwo(int x, int y, int color, int size)
+
+int DrawLineTo(Frame* frame, int x, int y, int color)
 {
+	if (frame->recorder) {
+		StrokeRecorderLineTo(frame->recorder, frame->x_start, frame->y_start, x, y, color);
+		frame->x_start = x;
+		frame->y_start = y;
+		return frame->num_points - 1;
+	}
 
-	DrawLineTo(x, y, 0);
-	DrawLineTo(x +size, y, color);
-	DrawLineTo(x +size, y- size, color);
-	DrawLineTo(x, y - size, color);
-	DrawLineTo(x, y - 2*size, color);
-	DrawLineTo(x+size, y - 2*size, color);
+	// Color and clipping are settled once for the whole line, the kernel only clamps.
+	// Both ends bound the line, so it needs clipping if either end is outside the DAC range.
+	if (color > 0)
+		NoteClipping(x > 4095 || frame->x_start > 4095, y > 4095 || frame->y_start > 4095);
+	else
+		NoteClipping(x > 4095, y > 4095);
 
-}
-void DrawThree(int x, int y, int color, int size)
-{
-	DrawLineTo(x, y, 0);
-	DrawLineTo(x + size, y, color);
-	DrawLineTo(x + size, y - 2* size, color);
-	DrawLineTo(x, y - 2*size, color);
-	DrawLineTo(x, y - size, 0);
-	DrawLineTo(x+size, y - size, color);
+	HeliosDacClass::HeliosPoint point = PalettePoint(color);
 
-}
-void DrawFour(int x, int y, int color, int size)
-{
-	DrawLineTo(x, y, 0);
-	DrawLineTo(x, y - size, color);
-	DrawLineTo(x + size, y - size, color);
-	DrawLineTo(x + size, y, 0);
-	DrawLineTo(x + size, y - 2 * size, color);
+	if (motion)
+		return MotionLineTo(frame, x, y, color, &point);
 
-}
-void DrawFive(int x, int y, int color, int size)
-{
-	DrawLineTo(x+size, y, 0);
-	DrawLineTo(x, y, color);
-	DrawLineTo(x, y - size, color);
-	DrawLineTo(x + size, y - size, color);
-	DrawLineTo(x + size, y - 2*size, color);
-	DrawLineTo(x, y - 2*size, color);
+	if (color > 0) {
+		float x_length = x - frame->x_start;
+		float y_length = y - frame->y_start;
+		float vector_length = sqrtf((x_length * x_length) + (y_length * y_length));
 
-}
-void DrawSix(int x, int y, int color, int size)
-{
-	DrawLineTo(x+size, y, 0);
-	DrawLineTo(x, y, color);
-	DrawLineTo(x, y - 2 * size, color);
-	DrawLineTo(x + size, y - 2 * size, color);
-	DrawLineTo(x + size, y - size, color);
-	DrawLineTo(x, y - size, color);
-}
-void DrawSeven(int x, int y, int color, int size)
-{
-	DrawLineTo(x, y, 0);
-	DrawLineTo(x + size, y, color);
-	DrawLineTo(x + size, y - 2 * size, color);
-}
-void DrawEight(int x, int y, int color, int size)
-{
-	DrawLineTo(x, y, 0);
-	DrawLineTo(x + size, y, color);
-	DrawLineTo(x + size, y - 2 * size, color);
-	DrawLineTo(x, y - 2 * size, color);
-	DrawLineTo(x, y, color);
-	DrawLineTo(x, y-size, 0);
-	DrawLineTo(x+size, y- size, color);
-}
-void DrawNine(int x, int y, int color, int size)
-{
-	DrawLineTo(x + size, y-2*size, 0);
-	DrawLineTo(x + size, y, color);
-	DrawLineTo(x,  y, color);
-	DrawLineTo(x, y - size, color);
-	DrawLineTo(x+size, y-size, color);
+		// Interpolate from the previous point (x_start, y_start) to the new point (x,y).
+		int num_segments = ceilf(vector_length/divider);
+
+		frame->num_points += InterpolateLine(&frame->points[frame->num_points], frame->x_start, frame->y_start, x, y,
+				num_segments, FrameRoom(frame, num_segments), &point);
+	}
+
+	// dwell at the end point, one duration for hidden vectors, 
+	// another duration for visible vectors
+	int count = (color == 0) ? hidden_dwell : dwell;
+	count = FrameRoom(frame, count);
+
+	point.x = (x < 0) ? 0 : (x > 4095) ? 4095 : x;
+	point.y = (y < 0) ? 0 : (y > 4095) ? 4095 : y;
+	frame->num_points += FillPoints(&frame->points[frame->num_points], &point, count);
+
+	frame->x_start = x;
+	frame->y_start = y;
+	
+	return frame->num_points - 1;
 }
 
-int DrawDigit(int n, int x, int y, int color, int size)
+int DrawDigit(Frame* frame, int n, int x, int y, int color, int size)
 {
-
-	switch (n) {
-		case 0: DrawZero(x, y, color, size); break;
-		case 1: DrawOne(x, y, color, size); break;
-		case 2: DrawTwo(x, y, color, size); break;
-		case 3: DrawThree(x, y, color, size); break;
-		case 4: DrawFour(x, y, color, size); break;
-		case 5: DrawFive(x, y, color, size); break;
-		case 6: DrawSix(x, y, color, size); break;
-		case 7: DrawSeven(x, y, color, size); break;
-		case 8: DrawEight(x, y, color, size); break;
-		case 9: DrawNine(x, y, color, size); break;
-		default: break;
-	}
+	if (n >= 0 && n <= 9)
+		DrawChar(frame, '0' + n, x, y, color, size);
 	return 0;
 }
 
-
-
-int DrawSquare(int x, int y, int color, int size)
+int DrawSquare(Frame* frame, int x, int y, int color, int size)
 {
 	int offset = size/2;
 
-	DrawLineTo(x - offset, y - offset, 0);
-	DrawLineTo(x - offset +size, y - offset, color);
-	DrawLineTo(x - offset +size, y - offset +size, color);
-	DrawLineTo(x - offset, y - offset +size, color);
-	DrawLineTo(x - offset, y - offset, color);
+	DrawLineTo(frame, x - offset, y - offset, 0);
+	DrawLineTo(frame, x - offset +size, y - offset, color);
+	DrawLineTo(frame, x - offset +size, y - offset +size, color);
+	DrawLineTo(frame, x - offset, y - offset +size, color);
+	DrawLineTo(frame, x - offset, y - offset, color);
 
 	return 0;
 }
 
-int DrawCircle(int x, int y, int color, float radius, float stepsize)
+int DrawCircle(Frame* frame, int x, int y, int color, float radius, float stepsize)
 {
-	
-	DrawLineTo(x+radius, y, 0);
-	for (float theta = 0.0 - (0.5 * stepsize); theta < (360.0 + (0.5 * stepsize)); theta += stepsize) {
-		float xf = radius * cos(theta * 3.1415926 / 180.0);
-		float yf = radius * sin(theta * 3.1415926 / 180.0);
-		DrawLineTo((int)xf + x, (int)yf + y, color);
-	}
+	DrawArcSteps(frame, x, y, color, radius, 0, 360, stepsize);
 
 	return 0;
 }
 
+// The offline benchmark (bench.cpp) links the drawing code above with its own main.
+#ifndef LASERCLOCK_BENCH
+
+// Logs the time now being displayed.
+static void Announce(time_t t)
+{
+	struct tm tm;
+
+	localtime_r(&t, &tm);
+	fprintf(stderr, "now: %d-%d-%d %02d:%02d:%02d\n", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
 int main(int argc, char ** argv)
 {
 
@@ -352,48 +458,286 @@ int main(int argc, char ** argv)
 			hidden_dwell = atoi(argv[i+1]);
 		if (strcasecmp(argv[i],"-divider") == 0)
 			divider = atof(argv[i+1]);
+		if (strcasecmp(argv[i],"-optimize_path") == 0)
+			optimize_path = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-motion") == 0)
+			motion = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-scan_speed") == 0)
+			scan_speed = atof(argv[i+1]);
+		if (strcasecmp(argv[i],"-scan_accel") == 0)
+			scan_accel = atof(argv[i+1]);
+		if (strcasecmp(argv[i],"-auto_budget") == 0)
+			auto_budget = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-target_fps") == 0)
+			target_fps = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-adapt_pps") == 0)
+			adapt_pps = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-max_pps") == 0)
+			max_pps = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-render_ahead") == 0)
+			render_ahead = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-edge_sync") == 0)
+			edge_sync = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-latency_us") == 0)
+			latency_us = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-multi_dac") == 0)
+			multi_dac = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-usb_async") == 0)
+			usb_async = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-hotplug") == 0)
+			hotplug = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-send_on_change") == 0)
+			send_on_change = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-dac_offset") == 0 && i + 3 < argc) {
+			int dac = atoi(argv[i+1]);
+			if (dac >= 0 && dac < HELIOS_MAX_DEVICES) {
+				dac_layout[dac].dx = atoi(argv[i+2]);
+				dac_layout[dac].dy = atoi(argv[i+3]);
+			}
+		}
+		if (strcasecmp(argv[i],"-homography") == 0 && i + 1 < argc && !SetHomography(argv[i+1]))
+			exit(1);
+		if (strcasecmp(argv[i],"-corners") == 0 && i + 1 < argc && !SetCorners(argv[i+1]))
+			exit(1);
+		if (strcasecmp(argv[i],"-pincushion") == 0)
+			pincushion = atof(argv[i+1]);
+		if (strcasecmp(argv[i],"-correction_grid") == 0 && i + 1 < argc)
+			correction_grid = argv[i+1];
+		if (strcasecmp(argv[i],"-sched") == 0) {
+			sched_mode = ParseSchedMode(argv[i+1]);
+			if (sched_mode < 0) {
+				fprintf(stderr, "Unknown -sched mode %s, use spin or sleep..\n", argv[i+1]);
+				exit(1);
+			}
+		}
+		if (strcasecmp(argv[i],"-poll_us") == 0)
+			poll_us = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-rt_priority") == 0)
+			rt_priority = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-rt_cpu") == 0)
+			rt_cpu = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-jitter_interval") == 0)
+			jitter_interval = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-stats_file") == 0 && i + 1 < argc)
+			stats_file = argv[i+1];
+		if (strcasecmp(argv[i],"-stats_interval") == 0)
+			stats_interval = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-ilda_file") == 0 && i + 1 < argc)
+			ilda_file = argv[i+1];
+		if (strcasecmp(argv[i],"-stream") == 0 && i + 1 < argc)
+			stream_to = argv[i+1];
+		if (strcasecmp(argv[i],"-sink_seconds") == 0)
+			sink_seconds = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-frame_cache") == 0 && i + 1 < argc)
+			frame_cache = argv[i+1];
+		if (strcasecmp(argv[i],"-udp_port") == 0)
+			udp_port = atoi(argv[i+1]);
+		if (strcasecmp(argv[i],"-udp_group") == 0 && i + 1 < argc)
+			udp_group = argv[i+1];
+		if (strcasecmp(argv[i],"-date_zone") == 0 && i + 1 < argc && !AddZone(ZONE_DATE, argv[i+1]))
+			exit(1);
+		if (strcasecmp(argv[i],"-temp_zone") == 0 && i + 1 < argc && !AddZone(ZONE_TEMP, argv[i+1]))
+			exit(1);
+		if (strcasecmp(argv[i],"-temp_file") == 0 && i + 1 < argc)
+			temp_file = argv[i+1];
+		if (strcasecmp(argv[i],"-temp_interval") == 0)
+			temp_interval = atoi(argv[i+1]);
+	}
+
+	if (adapt_pps && target_fps <= 0) {
+		fprintf(stderr, "-adapt_pps needs -target_fps..\n");
+		exit(1);
 	}
 
+	if (correction_grid != NULL && !LoadCorrectionGrid())
+		exit(1);
+
+	// Pushed content is rendered the moment it arrives, not ahead of a second edge.
+	if (udp_port > 0 && (render_ahead || edge_sync || frame_cache != NULL)) {
+		fprintf(stderr, "-udp_port renders on demand, -render_ahead, -edge_sync and -frame_cache are ignored..\n");
+		render_ahead = 0;
+		edge_sync = 0;
+		frame_cache = NULL;
+	}
+
+	// The cache holds the clock alone, rendered long before any zone's content is known.
+	if (frame_cache != NULL && NumZones() > 0) {
+		fprintf(stderr, "-frame_cache holds only the clock, -date_zone and -temp_zone are ignored..\n");
+		ClearZones();
+	}
+
+	static FrameSink sinks[2];
+	int numSinks = 0;
+	if (ilda_file != NULL) {
+		if (!OpenIldaSink(&sinks[numSinks], ilda_file))
+			exit(1);
+		numSinks++;
+	}
+	if (stream_to != NULL) {
+		if (!OpenStreamSink(&sinks[numSinks], stream_to))
+			exit(1);
+		numSinks++;
+	}
+
+	// Read the same clock the scheduler waits on; time() can lag it by a tick around the edge.
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	time_t t = now.tv_sec;
+
+	// Pre-generating content needs no DAC, and does not wait for the clock.
+	if (sink_seconds > 0) {
+		if (numSinks == 0) {
+			fprintf(stderr, "-sink_seconds needs -ilda_file or -stream..\n");
+			exit(1);
+		}
+		bool ok = RenderToSinks(sinks, numSinks, t, sink_seconds);
+		for (int i = 0; i < numSinks; i++)
+			CloseSink(&sinks[i]);
+		exit(ok ? 0 : 1);
+	}
+
+	// Rendered now if it is missing or stale, before the DACs are claimed.
+	if (frame_cache != NULL && !OpenFrameCache())
+		exit(1);
+
 	//connect to DACs and output vector_lists
+	//with -usb_async the DACs are opened by HeliosAsync, HeliosDacClass must not claim them too
 	HeliosDacClass helios;
-	int numDevs = helios.OpenDevices();
+	HeliosAsync usb;
+	// With -hotplug the DACs are opened by the output thread as they turn up, so every one
+	// that could be driven gets a worker now.
+	int numDevs;
+	if (hotplug) {
+		usb_async = 1;
+		if (!usb.WatchDevices()) {
+			fprintf(stderr, "Could not initialise libusb..\n");
+			exit(1);
+		}
+		numDevs = multi_dac ? HELIOS_MAX_DEVICES : 1;
+	} else {
+		numDevs = usb_async ? usb.OpenDevices() : helios.OpenDevices();
+	}
 
-	if (numDevs < 1) {
+	// With a sink to write to the clock runs without a DAC.
+	if (numDevs < 1 && numSinks == 0) {
 		fprintf(stderr, "No Helios DAC found .. \n");
 		exit(0);
 	}
 
+	int numDacs = (numDevs < 1) ? 0 : multi_dac ? numDevs : 1;
+	if (numDacs > HELIOS_MAX_DEVICES)
+		numDacs = HELIOS_MAX_DEVICES;
+
+	// The front buffer is on the DACs, the next second is rendered into the back buffer;
+	// ahead of time on the producer thread when -render_ahead is set.
+	static ClockFrame buffers[2];
+	if (!InitClockFrame(&buffers[0]) || !InitClockFrame(&buffers[1])) {
+		fprintf(stderr, "Out of memory for the frame buffers..\n");
+		exit(1);
+	}
+	int front = 0;
+
+	// With -frame_cache nothing is rendered; the published frames are views on the cache instead.
+	static Frame views[2];
+	Frame* frames[2] = { &buffers[0].frame, &buffers[1].frame };
+	if (frame_cache != NULL) {
+		frames[0] = &views[0];
+		frames[1] = &views[1];
+		render_ahead = 0;
+	}
+
+	if (frame_cache != NULL)
+		CachedFrame(frames[front], t);
+	else
+		RenderClockFrame(&buffers[front], t);
+	// Locked once everything the output threads read is allocated, and before they start.
+	LockMemory();
+	if (numDacs > 0 && !(usb_async ? StartAsyncDacOutputs(&usb, numDacs) : StartDacOutputs(&helios, numDacs)))
+		exit(1);
+	if (!StartSinkOutputs(sinks, numSinks))
+		exit(1);
+	PublishFrame(frames[front], 0);
+	Announce(t);
+	WriteStatsIfDue();
+
+	if (render_ahead) {
+		if (!StartRenderThread())
+			exit(1);
+		QueueRender(&buffers[1 - front], t + 1);
+	}
+
+	Content content;
+	memset(&content, 0, sizeof(content));
+	content.kind = CONTENT_CLOCK;
+	if (udp_port > 0 && !StartContentServer())
+		exit(1);
+
 	while(1) {
-  		
-		time_t t = time(NULL);
-		struct tm tm = *localtime(&t);
-		num_points = MAX_POINTS;
-		num_points = 0;
-		
-		DrawDigit(tm.tm_hour/10, xpos, ypos, color, size);
-		DrawDigit(tm.tm_hour%10, xpos + 2*size, ypos, color, size);
-		
-		DrawDigit(tm.tm_min/10, xpos + 4*size, ypos, color, size);
-		DrawDigit(tm.tm_min%10, xpos + 6*size, ypos, color, size);
+		struct timespec next_second = NextSecondEdge(t);
+		bool updated = false;
+
+		// With -udp_port an update ends the wait early.  With -edge_sync the next frame has to
+		// be queued to light up on the edge, so stop repeating this one a frame period before that.
+		if (udp_port > 0) {
+			updated = WaitForContent(&next_second, &content);
+		} else if (edge_sync) {
+			struct timespec feed_until = FeedDeadline(&next_second, frames[front]->num_points, frames[front]->pps);
+			HoldOutput(&feed_until);
+			SleepUntil(&feed_until);
+		} else {
+			SleepUntil(&next_second);
+		}
 
-		DrawDigit(tm.tm_sec/10, xpos + 8*size, ypos, color, size);
-		DrawDigit(tm.tm_sec%10, xpos + 10*size, ypos, color, size);
-	
-	
-		DrawSquare(xpos + (int)(3.5 * size), ypos - size/2, color, size/10);
-		DrawSquare(xpos + (int)(3.5 * size), (ypos - size/2) - size, color, size/10);	
-		DrawSquare(xpos + (int)(7.5 * size), ypos - size/2, color, size/10);
-		DrawSquare(xpos + (int)(7.5 * size), (ypos - size/2) - size, color, size/10);	
-	
+		clock_gettime(CLOCK_REALTIME, &now);
+		time_t next = now.tv_sec;
+		if (edge_sync && next == t)
+			next = t + 1;
+
+		ClockFrame* back = &buffers[1 - front];
+		if (udp_port > 0) {
+			RenderContent(back, &content, next);
+		} else if (frame_cache != NULL) {
+			CachedFrame(frames[1 - front], next);
+		} else if (!render_ahead) {
+			RenderClockFrame(back, next);
+		} else if (WaitRender() != next) {
+			// The clock jumped, so the frame rendered ahead is for the wrong second.
+			fprintf(stderr, "Frame rendered ahead is for the wrong second, rendering late..\n");
+			StatsRenderMiss();
+			RenderClockFrame(back, next);
+		}
+
+		if (edge_sync) {
+			struct timespec switch_at = SwitchTime(&next_second);
+			SleepUntil(&switch_at);
+		}
+
+		int old_points = frames[front]->num_points;
+		int old_pps = frames[front]->pps;
+		front = 1 - front;
+		PublishFrame(frames[front], (edge_sync || updated) ? HELIOS_FLAGS_START_IMMEDIATELY : 0);
+		if (render_ahead)
+			QueueRender(&buffers[1 - front], next + 1);
+
+		// With -edge_sync the new frame is late once it is published past the edge, otherwise
+		// once the DAC has played a whole frame of the old second.  Pushed content arrives
+		// between edges, so it is not timed.
+		if (!updated) {
+			clock_gettime(CLOCK_REALTIME, &now);
+			long lag = (now.tv_sec - next_second.tv_sec) * 1000000000L + (now.tv_nsec - next_second.tv_nsec);
+			long allowed = edge_sync ? 0 : (long)(old_points * 1000000000LL / old_pps);
+			StatsFramePublished(lag, lag > allowed);
+			if (next > t + 1)
+				StatsSkippedSeconds((int)(next - t - 1));
+		}
 
-		fprintf(stderr, "now: %d-%d-%d %02d:%02d:%02d\n", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
-		int seconds = tm.tm_sec;
-		while(tm.tm_sec == seconds)
-		{
-			t = time(NULL);
-			tm = *localtime(&t);
-			while(helios.GetStatus(0) == 0);
-			helios.WriteFrame(0, POINTS_PER_SECOND, 0, vector_list, num_points);
+		// Logged after the new frame is on its way, so it does not delay the rollover.
+		if (next != t) {
+			t = next;
+			Announce(t);
 		}
+		WriteStatsIfDue();
 	}
 }
+
+#endif
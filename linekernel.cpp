@@ -0,0 +1,134 @@
+//Line interpolation kernel, see linekernel.h
+//Define LINEKERNEL_NO_SIMD to build only the scalar path, e.g. to compare against it.
+
+#include "linekernel.h"
+#include <string.h>
+
+#if !defined(LINEKERNEL_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define LINEKERNEL_SSE2
+#elif !defined(LINEKERNEL_NO_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LINEKERNEL_NEON
+#endif
+
+// The vector paths store a point as one 64 bit word: x, y, then r, g, b, i.
+static_assert(sizeof(HeliosDacClass::HeliosPoint) == 8, "HeliosPoint layout changed");
+
+static inline int Clamp(int v)
+{
+	if (v < 0) return 0;
+	if (v > 4095) return 4095;
+	return v;
+}
+
+int InterpolateLine(HeliosDacClass::HeliosPoint* out, int x0, int y0, int x1, int y1, int steps, int max,
+		const HeliosDacClass::HeliosPoint* proto)
+{
+	if (steps <= 0)
+		return 0;
+
+	int count = steps < max ? steps : max;
+
+	// 16.16 fixed point, with the half unit added up front so the shift rounds to nearest.
+	// Multiplied rather than shifted up, as the differences and glyph offsets can be negative.
+	int x_step = (int)((x1 - x0) * 65536LL / steps);
+	int y_step = (int)((y1 - y0) * 65536LL / steps);
+	int x_fixed = x0 * 65536 + 0x8000 + x_step;
+	int y_fixed = y0 * 65536 + 0x8000 + y_step;
+	int i = 0;
+
+#if defined(LINEKERNEL_SSE2)
+	uint32_t rgbi;
+	memcpy(&rgbi, &proto->r, sizeof(rgbi));
+
+	__m128i vx = _mm_add_epi32(_mm_set1_epi32(x_fixed), _mm_setr_epi32(0, x_step, 2*x_step, 3*x_step));
+	__m128i vy = _mm_add_epi32(_mm_set1_epi32(y_fixed), _mm_setr_epi32(0, y_step, 2*y_step, 3*y_step));
+	const __m128i vx_step = _mm_set1_epi32(4*x_step);
+	const __m128i vy_step = _mm_set1_epi32(4*y_step);
+	const __m128i vcolor = _mm_set1_epi32(rgbi);
+	const __m128i vmin = _mm_setzero_si128();
+	const __m128i vmax = _mm_set1_epi16(4095);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i px = _mm_packs_epi32(_mm_srai_epi32(vx, 16), _mm_srai_epi32(vx, 16));
+		__m128i py = _mm_packs_epi32(_mm_srai_epi32(vy, 16), _mm_srai_epi32(vy, 16));
+		px = _mm_min_epi16(_mm_max_epi16(px, vmin), vmax);
+		py = _mm_min_epi16(_mm_max_epi16(py, vmin), vmax);
+
+		__m128i xy = _mm_unpacklo_epi16(px, py);
+		_mm_storeu_si128((__m128i*)&out[i], _mm_unpacklo_epi32(xy, vcolor));
+		_mm_storeu_si128((__m128i*)&out[i + 2], _mm_unpackhi_epi32(xy, vcolor));
+
+		vx = _mm_add_epi32(vx, vx_step);
+		vy = _mm_add_epi32(vy, vy_step);
+	}
+	x_fixed += i * x_step;
+	y_fixed += i * y_step;
+#elif defined(LINEKERNEL_NEON)
+	uint32_t rgbi;
+	memcpy(&rgbi, &proto->r, sizeof(rgbi));
+
+	const int32_t x_lanes[4] = { 0, x_step, 2*x_step, 3*x_step };
+	const int32_t y_lanes[4] = { 0, y_step, 2*y_step, 3*y_step };
+	int32x4_t vx = vaddq_s32(vdupq_n_s32(x_fixed), vld1q_s32(x_lanes));
+	int32x4_t vy = vaddq_s32(vdupq_n_s32(y_fixed), vld1q_s32(y_lanes));
+	const int32x4_t vx_step = vdupq_n_s32(4*x_step);
+	const int32x4_t vy_step = vdupq_n_s32(4*y_step);
+	const uint32x2_t vcolor = vdup_n_u32(rgbi);
+	const int16x4_t vmin = vdup_n_s16(0);
+	const int16x4_t vmax = vdup_n_s16(4095);
+
+	for (; i + 4 <= count; i += 4) {
+		int16x4_t px = vmin_s16(vmax_s16(vqmovn_s32(vshrq_n_s32(vx, 16)), vmin), vmax);
+		int16x4_t py = vmin_s16(vmax_s16(vqmovn_s32(vshrq_n_s32(vy, 16)), vmin), vmax);
+
+		int16x4x2_t xy = vzip_s16(px, py);
+		uint32x2x2_t p01 = vzip_u32(vreinterpret_u32_s16(xy.val[0]), vcolor);
+		uint32x2x2_t p23 = vzip_u32(vreinterpret_u32_s16(xy.val[1]), vcolor);
+		vst1q_u32((uint32_t*)&out[i], vcombine_u32(p01.val[0], p01.val[1]));
+		vst1q_u32((uint32_t*)&out[i + 2], vcombine_u32(p23.val[0], p23.val[1]));
+
+		vx = vaddq_s32(vx, vx_step);
+		vy = vaddq_s32(vy, vy_step);
+	}
+	x_fixed += i * x_step;
+	y_fixed += i * y_step;
+#endif
+
+	for (; i < count; i++) {
+		out[i] = *proto;
+		out[i].x = Clamp(x_fixed >> 16);
+		out[i].y = Clamp(y_fixed >> 16);
+		x_fixed += x_step;
+		y_fixed += y_step;
+	}
+
+	return count;
+}
+
+int FillPoints(HeliosDacClass::HeliosPoint* out, const HeliosDacClass::HeliosPoint* point, int count)
+{
+	int i = 0;
+
+#if defined(LINEKERNEL_SSE2) || defined(LINEKERNEL_NEON)
+	uint64_t bits;
+	memcpy(&bits, point, sizeof(bits));
+#endif
+
+#if defined(LINEKERNEL_SSE2)
+	const __m128i vpoint = _mm_set1_epi64x((long long)bits);
+
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_si128((__m128i*)&out[i], vpoint);
+#elif defined(LINEKERNEL_NEON)
+	const uint64x2_t vpoint = vdupq_n_u64(bits);
+
+	for (; i + 2 <= count; i += 2)
+		vst1q_u64((uint64_t*)&out[i], vpoint);
+#endif
+
+	for (; i < count; i++)
+		out[i] = *point;
+	return count;
+}
@@ -0,0 +1,17 @@
+//Line interpolation kernel.  Emits the points of a segment straight into a HeliosPoint array
+//with 16.16 fixed-point stepping, four points per iteration with SSE2 or NEON where the
+//compiler provides them.  Coordinates are clamped to the 0..4095 DAC range.
+
+#include "main.h"
+
+#pragma once
+
+//Writes the points 1..steps of the segment from (x0,y0) to (x1,y1), all in the color and
+//intensity of proto, stopping after max points.  Point i sits at i/steps of the way along,
+//rounded to the nearest DAC unit, so the last point lands exactly on (x1,y1).
+//Returns the number of points written.
+int InterpolateLine(HeliosDacClass::HeliosPoint* out, int x0, int y0, int x1, int y1, int steps, int max,
+		const HeliosDacClass::HeliosPoint* proto);
+
+//Writes count copies of point, two per store with SSE2 or NEON.  Returns count.
+int FillPoints(HeliosDacClass::HeliosPoint* out, const HeliosDacClass::HeliosPoint* point, int count);
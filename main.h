@@ -1 +1,94 @@
-#include "HeliosDacClass.h"
\ No newline at end of file
+#include "HeliosDacClass.h"
+
+#pragma once
+
+#define MAX_POINTS 10000
+#define MAX_PTS_FRAME 1000
+#define POINTS_PER_SECOND 30000
+#define FULL_BRIGHTNESS 256	// Frame.brightness that leaves the colors as drawn
+
+// WriteFrame flags, see HeliosDacClass.h
+#define HELIOS_FLAGS_START_IMMEDIATELY	0x01	// replace the playing frame instead of queueing after it
+#define HELIOS_FLAGS_SINGLE_MODE	0x02	// play the frame once instead of repeating it
+
+// Repeats of an unchanged clipping report are held back for this many seconds.
+#define CLIP_REPORT_INTERVAL 10
+
+struct StrokeList;
+struct PointRun;
+
+// A frame being assembled by the drawing routines.  Each thread draws into its own.
+typedef struct Frame
+{
+	HeliosDacClass::HeliosPoint* points;	// from the point arena, see InitFrame
+	int capacity;
+	int num_points;
+
+	// Set when a drawing routine ran out of room and dropped points, until ClearFrame.
+	bool overflow;
+
+	// Pen position, where the next DrawLineTo starts from.
+	int x_start;
+	int y_start;
+
+	// When set, DrawLineTo records the visible geometry here instead of emitting points.
+	struct StrokeList* recorder;
+
+	// With -motion, the dwell after the last visible line, which the next line trims to suit
+	// its turn angle as long as nothing else was drawn since (num_points is still tail_end).
+	int tail_end;
+	int tail_dwell;
+	float tail_dx;	// unit direction of that line
+	float tail_dy;
+
+	// When set the frame is these runs instead of points (see pointruns.h), read only, and
+	// num_points is the number of points they expand to.
+	const struct PointRun* runs;
+	int num_runs;
+
+	// Point rate to play the frame at, and the scale of its colors out of FULL_BRIGHTNESS.
+	// POINTS_PER_SECOND and FULL_BRIGHTNESS unless -adapt_pps sets them, see pointbudget.h.
+	int pps;
+	int brightness;
+} Frame;
+
+// Render settings, set from the command line.
+extern int xpos;
+extern int ypos;
+extern int size;
+extern int color;
+extern float divider;
+extern int dwell;
+extern int hidden_dwell;
+
+// Returns a point with the color and intensity for a color number, at (0,0).
+HeliosDacClass::HeliosPoint PalettePoint(int color);
+
+// Counts a shape (vector or cached glyph) drawn outside the DAC range in x and/or y.
+void NoteClipping(bool x, bool y);
+
+// Prints what was clipped since the last call, at most once per frame.
+void ReportClipping();
+
+// Gives the frame MAX_POINTS of storage from the point arena, unless it already has some, and
+// empties it.  Returns false if out of memory.
+bool InitFrame(Frame* frame);
+
+// Returns the frame's storage to the point arena.
+void ReleaseFrame(Frame* frame);
+
+// Empties the frame, moves the pen to (0,0) and puts the point rate and brightness back to the defaults.
+void ClearFrame(Frame* frame);
+
+// Cuts the frame back to its first num_points, as if nothing after them had been drawn.
+void TruncateFrame(Frame* frame, int num_points);
+
+// Returns how many of count more points the frame has room for, and marks it overflowed if
+// that is not all of them.
+int FrameRoom(Frame* frame, int count);
+
+int DrawPoint(Frame* frame, int x, int y, int color);
+int DrawLineTo(Frame* frame, int x, int y, int color);
+int DrawDigit(Frame* frame, int n, int x, int y, int color, int size);
+int DrawSquare(Frame* frame, int x, int y, int color, int size);
+int DrawCircle(Frame* frame, int x, int y, int color, float radius, float stepsize);
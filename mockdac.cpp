@@ -0,0 +1,133 @@
+//Mock Helios DAC backend for the offline benchmark.  Stands in for libHeliosDacAPI: one DAC that
+//is always ready and accepts every frame without any USB traffic, so the output path can be
+//timed without a projector attached.
+
+#include "HeliosDacClass.h"
+#include <stdio.h>
+
+HeliosDacClass::HeliosDacClass()
+{
+	inited = false;
+	dacController = NULL;
+}
+
+HeliosDacClass::~HeliosDacClass()
+{
+	CloseDevices();
+}
+
+int HeliosDacClass::OpenDevices()
+{
+	if (!inited) {
+		dacController = new HeliosDac();
+		inited = true;
+	}
+	return dacController->OpenDevices();
+}
+
+int HeliosDacClass::GetStatus(int dacNum)
+{
+	return (inited && dacNum == 0) ? 1 : -1;
+}
+
+int HeliosDacClass::WriteFrame(int dacNum, int pps, uint8_t flags, HeliosPoint* points, int numOfPoints)
+{
+	(void)flags;
+	(void)points;
+	if (!inited || dacNum != 0 || numOfPoints > HELIOS_MAX_POINTS || pps < HELIOS_MIN_RATE || pps > HELIOS_MAX_RATE)
+		return 0;
+	return 1;
+}
+
+int HeliosDacClass::SetShutter(int dacNum, bool shutterValue)
+{
+	(void)shutterValue;
+	return (inited && dacNum == 0) ? 1 : 0;
+}
+
+int HeliosDacClass::GetFirmwareVersion(int dacNum)
+{
+	return (inited && dacNum == 0) ? 0 : -1;
+}
+
+int HeliosDacClass::GetName(int dacNum, char* name)
+{
+	if (!inited || dacNum != 0)
+		return -1;
+	snprintf(name, 32, "Mock DAC");
+	return 1;
+}
+
+int HeliosDacClass::SetName(int dacNum, char* name)
+{
+	(void)name;
+	return (inited && dacNum == 0) ? 1 : 0;
+}
+
+int HeliosDacClass::Stop(int dacNum)
+{
+	return (inited && dacNum == 0) ? 1 : 0;
+}
+
+int HeliosDacClass::CloseDevices()
+{
+	delete dacController;
+	dacController = NULL;
+	inited = false;
+	return 1;
+}
+
+int HeliosDacClass::EraseFirmware(int dacNum)
+{
+	(void)dacNum;
+	return 0;
+}
+
+HeliosDac::HeliosDac()
+{
+	numOfDevices = 0;
+	inited = false;
+}
+
+HeliosDac::~HeliosDac()
+{
+	CloseDevices();
+}
+
+int HeliosDac::OpenDevices()
+{
+	inited = true;
+	numOfDevices = 1;
+	return numOfDevices;
+}
+
+int HeliosDac::CloseDevices()
+{
+	inited = false;
+	numOfDevices = 0;
+	return 0;
+}
+
+int HeliosDac::SendControl(int devNum, uint8_t* bufferAddress, int length)
+{
+	(void)bufferAddress;
+	(void)length;
+	return (inited && devNum == 0) ? 1 : -1;
+}
+
+int HeliosDac::GetControlResponse(int devNum, uint8_t* bufferAddress, int length)
+{
+	if (!inited || devNum != 0 || length < 2)
+		return -1;
+	bufferAddress[0] = 0x83;	//status, ready
+	bufferAddress[1] = 1;
+	return 1;
+}
+
+int HeliosDac::SendFrame(int devNum, uint8_t* bufferAddress, int bufferSize)
+{
+	(void)bufferAddress;
+	if (!inited || devNum != 0 || bufferSize < 5)
+		return 0;
+	return 1;
+}
@@ -0,0 +1,122 @@
+//Galvo motion model, see motion.h
+
+#include "motion.h"
+#include <math.h>
+#include <stdlib.h>
+
+int motion = 0;
+float scan_speed = DEFAULT_SCAN_SPEED;
+float scan_accel = DEFAULT_SCAN_ACCEL;
+
+//Limits actually used, so a zero or negative setting cannot stall the profile.
+static void Limits(float* speed, float* accel)
+{
+	*speed = (scan_speed >= 1.0f) ? scan_speed : 1.0f;
+	*accel = (scan_accel > 0.01f) ? scan_accel : 0.01f;
+}
+
+//Time in points to cover length from rest to rest, and the length spent accelerating.
+static float MoveTime(float length, float speed, float accel, float* ramp)
+{
+	float ramp_time = speed / accel;
+	*ramp = 0.5f * accel * ramp_time * ramp_time;
+
+	if (2 * *ramp >= length) {
+		// Never reaches full speed: accelerate to the middle, then decelerate.
+		*ramp = length / 2;
+		return 2 * sqrtf(length / accel);
+	}
+	return 2 * ramp_time + (length - 2 * *ramp) / speed;
+}
+
+//Distance covered after t of total time, on the profile MoveTime describes.
+static float Travelled(float t, float total, float length, float ramp, float speed, float accel)
+{
+	float ramp_time = (2 * ramp >= length) ? total / 2 : speed / accel;
+
+	if (t <= ramp_time)
+		return 0.5f * accel * t * t;
+	if (t >= total - ramp_time) {
+		float left = total - t;
+		return length - 0.5f * accel * left * left;
+	}
+	return ramp + (t - ramp_time) * speed;
+}
+
+int MotionLinePoints(HeliosDacClass::HeliosPoint* out, int x0, int y0, int x1, int y1, int max,
+		const HeliosDacClass::HeliosPoint* proto)
+{
+	float speed, accel, ramp;
+	float dx = x1 - x0;
+	float dy = y1 - y0;
+	float length = sqrtf(dx * dx + dy * dy);
+
+	if (length == 0)
+		return 0;
+
+	Limits(&speed, &accel);
+	float total = MoveTime(length, speed, accel, &ramp);
+
+	// Whole samples only; the profile is stretched slightly so the last one lands on the end.
+	int steps = (int)ceilf(total);
+	if (steps < 1)
+		steps = 1;
+	float scale = total / steps;
+	int full = steps;
+
+	if (steps > max)
+		steps = max;
+	for (int i = 1; i <= steps; i++) {
+		float s = (i == full) ? length : Travelled(i * scale, total, length, ramp, speed, accel);
+		int x = x0 + (int)lrintf(dx * s / length);
+		int y = y0 + (int)lrintf(dy * s / length);
+
+		out[i - 1] = *proto;
+		out[i - 1].x = (x < 0) ? 0 : (x > 4095) ? 4095 : x;
+		out[i - 1].y = (y < 0) ? 0 : (y > 4095) ? 4095 : y;
+	}
+	return full;
+}
+
+int MotionCornerDwell(float ux0, float uy0, float ux1, float uy1)
+{
+	float turn = (1.0f - (ux0 * ux1 + uy0 * uy1)) / 2;	//0 straight on, 1 reversing
+
+	if (turn < 0.0f) turn = 0.0f;
+	if (turn > 1.0f) turn = 1.0f;
+	return (int)ceilf(dwell * turn - 0.001f);
+}
+
+float MotionCurveStep(float radius, float done, float left)
+{
+	float speed, accel;
+
+	Limits(&speed, &accel);
+
+	// Going round a bend at v takes v*v/radius of acceleration.
+	float step = sqrtf(accel * radius);
+	if (step > speed)
+		step = speed;
+
+	// Half the acceleration is the first step of any move from rest, see Travelled.
+	float ramp = sqrtf(2 * accel * (done < left ? done : left));
+	if (ramp < accel / 2)
+		ramp = accel / 2;
+	return (step < ramp) ? step : ramp;
+}
+
+int MotionJumpDwell(int x0, int y0, int x1, int y1)
+{
+	float speed, accel, ramp;
+	int dx = abs(x1 - x0);
+	int dy = abs(y1 - y0);
+
+	// X and Y galvos move at the same time, so a jump takes as long as its longer axis.
+	int length = dx > dy ? dx : dy;
+	if (length == 0)
+		return 0;
+
+	Limits(&speed, &accel);
+	int count = 1 + (int)ceilf(MoveTime(length, speed, accel, &ramp));
+	return (count < hidden_dwell) ? count : hidden_dwell;
+}
@@ -0,0 +1,41 @@
+//Galvo motion model.  Instead of cutting every vector into equal divider-sized steps with a fixed
+//dwell at the end, -motion 1 places points one DAC sample apart in time along a trapezoidal
+//velocity profile limited by the scanner's speed and acceleration: the beam starts and stops at
+//each vertex, so points are dense around corners and sparse along long straight runs.  The
+//dwell at a vertex scales with how sharply the path turns there, and a blank jump gets as many
+//points as the scanner needs to cover its distance, up to hidden_dwell.
+
+#include "main.h"
+
+#pragma once
+
+#define DEFAULT_SCAN_SPEED	100.0	//DAC units per point
+#define DEFAULT_SCAN_ACCEL	20.0	//DAC units per point per point
+
+//Non-zero to place points with the motion model, set with -motion.
+extern int motion;
+
+//Peak scanner speed in DAC units per point at POINTS_PER_SECOND, set with -scan_speed.
+extern float scan_speed;
+
+//Scanner acceleration limit in DAC units per point per point, set with -scan_accel.
+extern float scan_accel;
+
+//Writes the points of the visible segment from (x0,y0) to (x1,y1), excluding (x0,y0), one per
+//sample of a move that starts and ends at rest, in the color and intensity of proto, stopping
+//after max points.  The last point lands exactly on (x1,y1).  Returns the number of points the
+//segment needs, which is more than were written if max cut it short.
+int MotionLinePoints(HeliosDacClass::HeliosPoint* out, int x0, int y0, int x1, int y1, int max,
+		const HeliosDacClass::HeliosPoint* proto);
+
+//Returns the dwell needed at a vertex where the path turns from direction (ux0,uy0) into
+//(ux1,uy1), both unit vectors: none going straight on, the full dwell for a reversal.
+int MotionCornerDwell(float ux0, float uy0, float ux1, float uy1);
+
+//Returns the distance between points on a visible curve with radius of curvature radius, done
+//along it from where it started and left to go until it stops: the speed that keeps the
+//centripetal acceleration within scan_accel, ramped up from rest and back down to rest.
+float MotionCurveStep(float radius, float done, float left);
+
+//Returns the number of blanked points for a jump from (x0,y0) to (x1,y1), 0 if there is no jump.
+int MotionJumpDwell(int x0, int y0, int x1, int y1);
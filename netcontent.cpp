@@ -0,0 +1,229 @@
+//Network content, see netcontent.h
+
+#include "netcontent.h"
+#include "glyphcache.h"
+#include "pointbudget.h"
+#include "renderthread.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "strokefont.h"
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int udp_port = 0;
+const char* udp_group = NULL;
+
+static pthread_mutex_t content_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t content_cond = PTHREAD_COND_INITIALIZER;
+static Content pending;
+static bool has_pending = false;
+
+static uint32_t GetBigEndian32(const uint8_t* in)
+{
+	return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+//Decodes a packet into content.  Returns false if it is not a valid update.
+static bool ParseContent(const uint8_t* packet, int length, Content* content, uint32_t* sequence)
+{
+	if (length < CONTENT_HEADER_SIZE || packet[0] != 'L' || packet[1] != 'C' || packet[2] != CONTENT_VERSION)
+		return false;
+
+	const uint8_t* payload = packet + CONTENT_HEADER_SIZE;
+	int size = length - CONTENT_HEADER_SIZE;
+
+	memset(content, 0, sizeof(*content));
+	*sequence = GetBigEndian32(&packet[4]);
+
+	switch (packet[3]) {
+		case 'C':
+			content->kind = CONTENT_CLOCK;
+			return true;
+		case 'T':
+			content->kind = CONTENT_TEXT;
+			for (int i = 0; i < size && i < MAX_CONTENT_TEXT && payload[i] != 0; i++)
+				content->text[i] = toupper(payload[i]);
+			return true;
+		case 'D':
+			if (size < 4)
+				return false;
+			content->kind = CONTENT_COUNTDOWN;
+			content->until = GetBigEndian32(payload);
+			return true;
+		default:
+			return false;
+	}
+}
+
+static int OpenListener()
+{
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		fprintf(stderr, "Could not create the UDP socket: %s..\n", strerror(errno));
+		return -1;
+	}
+
+	// Several clocks on one host can share a multicast port.
+	int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(udp_port);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		fprintf(stderr, "Could not listen on UDP port %d: %s..\n", udp_port, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	if (udp_group != NULL) {
+		struct ip_mreq mreq;
+		memset(&mreq, 0, sizeof(mreq));
+		mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+		if (inet_pton(AF_INET, udp_group, &mreq.imr_multiaddr) != 1 ||
+				setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+			fprintf(stderr, "Could not join multicast group %s..\n", udp_group);
+			close(fd);
+			return -1;
+		}
+	}
+	return fd;
+}
+
+static void* ContentServerThread(void* arg)
+{
+	int fd = *(int*)arg;
+	uint32_t last = 0;
+	bool have_last = false;
+
+	while (1) {
+		uint8_t packet[CONTENT_HEADER_SIZE + 64];
+		Content content;
+		uint32_t sequence;
+
+		int length = recv(fd, packet, sizeof(packet), 0);
+		if (length < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "UDP receive failed: %s, no longer taking content..\n", strerror(errno));
+			return NULL;
+		}
+
+		if (!ParseContent(packet, length, &content, &sequence))
+			continue;
+		if (have_last && sequence != 0 && (int32_t)(sequence - last) <= 0)
+			continue;
+		last = sequence;
+		have_last = true;
+
+		// Only the newest update is kept; one still pending is simply replaced.
+		pthread_mutex_lock(&content_lock);
+		pending = content;
+		has_pending = true;
+		pthread_cond_signal(&content_cond);
+		pthread_mutex_unlock(&content_lock);
+	}
+
+	return NULL;
+}
+
+int StartContentServer()
+{
+	static int fd;
+
+	fd = OpenListener();
+	if (fd < 0)
+		return 0;
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, ContentServerThread, &fd) != 0) {
+		fprintf(stderr, "Could not start the content server thread..\n");
+		close(fd);
+		return 0;
+	}
+	pthread_detach(thread);
+	return 1;
+}
+
+bool WaitForContent(const struct timespec* deadline, Content* content)
+{
+	pthread_mutex_lock(&content_lock);
+	while (!has_pending && !DeadlineReached(deadline)) {
+		if (pthread_cond_timedwait(&content_cond, &content_lock, deadline) == ETIMEDOUT)
+			break;
+	}
+
+	bool updated = has_pending;
+	if (updated) {
+		*content = pending;
+		has_pending = false;
+	}
+	pthread_mutex_unlock(&content_lock);
+
+	return updated;
+}
+
+//Lays the text out in cells two sizes apart from (xpos,ypos), as the clock places its digits.
+//A colon takes no cell of its own but sits in the gap before the next one, like the clock's.
+static void DrawContentText(Frame* frame, const char* text)
+{
+	int cell = 0;
+
+	for (const char* c = text; *c; c++) {
+		int x = xpos + cell * 2*size;
+
+		if (*c == ':') {
+			int colon_x = xpos + (int)((cell * 2 - 0.5) * size);
+			DrawCachedSquare(frame, colon_x, ypos - size/2);
+			DrawCachedSquare(frame, colon_x, (ypos - size/2) - size);
+			continue;
+		}
+
+		if (*c >= '0' && *c <= '9')
+			DrawCachedDigit(frame, *c - '0', x, ypos);
+		else if (FontHasChar(*c))
+			DrawChar(frame, *c, x, ypos, color, size);
+		cell++;
+	}
+}
+
+void RenderContent(ClockFrame* clock, const Content* content, time_t t)
+{
+	char text[MAX_CONTENT_TEXT + 1];
+
+	if (content->kind == CONTENT_CLOCK) {
+		RenderClockFrame(clock, t);
+		return;
+	}
+
+	if (content->kind == CONTENT_COUNTDOWN) {
+		time_t remaining = (content->until > t) ? content->until - t : 0;
+		int left = (remaining < INT_MAX) ? (int)remaining : INT_MAX;
+		if (left >= 3600)
+			snprintf(text, sizeof(text), "%d:%02d:%02d", left / 3600, (left / 60) % 60, left % 60);
+		else
+			snprintf(text, sizeof(text), "%02d:%02d", left / 60, left % 60);
+	} else {
+		memcpy(text, content->text, sizeof(text));
+	}
+
+	// The frame no longer holds the clock's slots, so the clock is rendered afresh next time.
+	InvalidateClockFrame(clock);
+	GlyphCacheUpdate();
+	ClearFrame(&clock->frame);
+	DrawContentText(&clock->frame, text);
+	SetFrameRate(&clock->frame);
+
+	ReportClipping();
+	StatsFrameRendered(clock->frame.num_points, clock->frame.overflow);
+}
@@ -0,0 +1,55 @@
+//Network content.  With -udp_port the clock listens for content pushed over UDP, to one
+//projector or, with -udp_group, to any number of them through a multicast group.  Updates are
+//coalesced: the listener only keeps the newest one, and the render loop wakes the moment it
+//arrives, renders it with the glyph cache and the stroke font, and replaces the playing frame
+//at once rather than at the next second.
+//
+//Each packet is "LC", a version byte (CONTENT_VERSION), a command byte and a 4 byte sequence
+//number (MSB first), followed by the command's payload:
+//
+//	'C'	show the wall clock again, no payload
+//	'T'	show text, up to MAX_CONTENT_TEXT characters of digits, ':', '.', '-', '/', the letters
+//		of the stroke font (A-F, H, J, L, M, N, O, P, R, S, T, U and Y, either case) and
+//		spaces; "12:34" is laid out as the clock lays out its digits
+//	'D'	count down to a time, a 4 byte Unix time (MSB first)
+//
+//A packet is only taken if its sequence number is newer than the last one taken, so updates
+//that arrive out of order never replace newer ones.  Sequence number 0 is always taken and
+//starts the count again, for a sender that restarts.
+
+#include "main.h"
+#include "clockframe.h"
+#include <time.h>
+
+#pragma once
+
+#define CONTENT_VERSION		1
+#define CONTENT_HEADER_SIZE	8
+#define MAX_CONTENT_TEXT	16
+
+#define CONTENT_CLOCK		0
+#define CONTENT_TEXT		1
+#define CONTENT_COUNTDOWN	2
+
+typedef struct
+{
+	int kind;	//CONTENT_CLOCK, CONTENT_TEXT or CONTENT_COUNTDOWN
+	char text[MAX_CONTENT_TEXT + 1];
+	time_t until;	//end of the countdown
+} Content;
+
+//UDP port to listen on, set with -udp_port.  0 shows only the wall clock.
+extern int udp_port;
+
+//Multicast group to join, set with -udp_group.  NULL listens for unicast only.
+extern const char* udp_group;
+
+//Starts the listener thread.  Returns 1 if successful.
+int StartContentServer();
+
+//Waits until CLOCK_REALTIME reaches the deadline or an update arrives, whichever is first.
+//Returns true, with the update in content, if one arrived.
+bool WaitForContent(const struct timespec* deadline, Content* content);
+
+//Renders content for wall clock time t into the clock frame.
+void RenderContent(ClockFrame* clock, const Content* content, time_t t);
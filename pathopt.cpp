@@ -0,0 +1,274 @@
+//Blanking path optimizer, see pathopt.h
+
+#include "pathopt.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int optimize_path = 0;
+
+//One stroke as placed in the tour.
+typedef struct
+{
+	int stroke;
+	bool reversed;
+	int entry;	//entry vertex, only varies for closed strokes
+} TourStep;
+
+void StrokeRecorderLineTo(StrokeList* list, int x0, int y0, int x1, int y1, int color)
+{
+	if (color == 0) {
+		list->pen_down = false;
+		return;
+	}
+
+	if (!list->pen_down) {
+		if (list->num_strokes >= MAX_STROKES)
+			return;
+		Stroke* stroke = &list->strokes[list->num_strokes++];
+		stroke->num_vertices = 1;
+		stroke->x[0] = x0;
+		stroke->y[0] = y0;
+		stroke->color = color;
+		stroke->closed = false;
+		list->pen_down = true;
+	}
+
+	Stroke* stroke = &list->strokes[list->num_strokes - 1];
+	if (stroke->num_vertices >= MAX_STROKE_VERTICES) {
+		fprintf(stderr, "Stroke has more than %d vertices, truncated..\n", MAX_STROKE_VERTICES);
+		return;
+	}
+	stroke->x[stroke->num_vertices] = x1;
+	stroke->y[stroke->num_vertices] = y1;
+	stroke->num_vertices++;
+}
+
+void FinishStrokes(StrokeList* list)
+{
+	for (int i = 0; i < list->num_strokes; i++) {
+		Stroke* stroke = &list->strokes[i];
+		int last = stroke->num_vertices - 1;
+		if (last >= 3 && stroke->x[last] == stroke->x[0] && stroke->y[last] == stroke->y[0]) {
+			stroke->num_vertices--;
+			stroke->closed = true;
+		}
+	}
+	list->pen_down = false;
+}
+
+bool AppendStrokes(StrokeList* dst, const StrokeList* src, int dx, int dy)
+{
+	for (int i = 0; i < src->num_strokes; i++) {
+		if (dst->num_strokes >= MAX_STROKES)
+			return false;
+		Stroke* stroke = &dst->strokes[dst->num_strokes++];
+		*stroke = src->strokes[i];
+		for (int v = 0; v < stroke->num_vertices; v++) {
+			stroke->x[v] += dx;
+			stroke->y[v] += dy;
+		}
+	}
+	return true;
+}
+
+int JumpLength(int x0, int y0, int x1, int y1)
+{
+	int dx = abs(x1 - x0);
+	int dy = abs(y1 - y0);
+	return dx > dy ? dx : dy;
+}
+
+static int EntryVertex(const Stroke* stroke, const TourStep* step)
+{
+	if (stroke->closed)
+		return step->entry;
+	return step->reversed ? stroke->num_vertices - 1 : 0;
+}
+
+static int ExitVertex(const Stroke* stroke, const TourStep* step)
+{
+	if (stroke->closed)
+		return step->entry;
+	return step->reversed ? 0 : stroke->num_vertices - 1;
+}
+
+//Cost of the blank jump from the exit of step a to the entry of step b.
+static int StepJump(const StrokeList* list, const TourStep* a, const TourStep* b)
+{
+	const Stroke* from = &list->strokes[a->stroke];
+	const Stroke* to = &list->strokes[b->stroke];
+	int exit = ExitVertex(from, a);
+	int entry = EntryVertex(to, b);
+	return JumpLength(from->x[exit], from->y[exit], to->x[entry], to->y[entry]);
+}
+
+static int TourLength(const StrokeList* list, const TourStep* tour, int n)
+{
+	int length = 0;
+	for (int i = 0; i < n; i++)
+		length += StepJump(list, &tour[i], &tour[(i + 1) % n]);
+	return length;
+}
+
+//Nearest neighbour tour starting from the given stroke.
+static void GreedyTour(const StrokeList* list, int first, TourStep* tour)
+{
+	int n = list->num_strokes;
+	bool used[MAX_STROKES] = { false };
+	int pen_x = list->strokes[first].x[0];
+	int pen_y = list->strokes[first].y[0];
+
+	for (int i = 0; i < n; i++) {
+		int best = -1;
+		TourStep best_step = { 0, false, 0 };
+		int best_length = 0;
+
+		for (int s = 0; s < n; s++) {
+			if (used[s] || (i == 0 && s != first))
+				continue;
+			const Stroke* stroke = &list->strokes[s];
+			int last = stroke->num_vertices - 1;
+
+			if (stroke->closed) {
+				for (int v = 0; v <= last; v++) {
+					int length = JumpLength(pen_x, pen_y, stroke->x[v], stroke->y[v]);
+					if (best < 0 || length < best_length) {
+						best = s;
+						best_step.stroke = s;
+						best_step.reversed = false;
+						best_step.entry = v;
+						best_length = length;
+					}
+				}
+			} else {
+				for (int r = 0; r < 2; r++) {
+					int v = r ? last : 0;
+					int length = JumpLength(pen_x, pen_y, stroke->x[v], stroke->y[v]);
+					if (best < 0 || length < best_length) {
+						best = s;
+						best_step.stroke = s;
+						best_step.reversed = r;
+						best_step.entry = 0;
+						best_length = length;
+					}
+				}
+			}
+		}
+
+		used[best] = true;
+		tour[i] = best_step;
+		const Stroke* stroke = &list->strokes[best];
+		int exit = ExitVertex(stroke, &best_step);
+		pen_x = stroke->x[exit];
+		pen_y = stroke->y[exit];
+	}
+}
+
+//Reverses tour[a..b], which also flips the direction each of those strokes is drawn in.
+static void ReverseSteps(TourStep* tour, int a, int b)
+{
+	while (a < b) {
+		TourStep t = tour[a];
+		tour[a] = tour[b];
+		tour[b] = t;
+		a++;
+		b--;
+	}
+}
+
+static void ReverseRange(TourStep* tour, int a, int b)
+{
+	ReverseSteps(tour, a, b);
+	for (int i = a; i <= b; i++)
+		tour[i].reversed = !tour[i].reversed;
+}
+
+//2-opt improvement: reverse any run of steps whose reversal shortens the tour.
+static void ImproveTour(const StrokeList* list, TourStep* tour, int n)
+{
+	bool improved = true;
+
+	while (improved) {
+		improved = false;
+		for (int a = 0; a < n - 1; a++) {
+			for (int b = a + 1; b < n; b++) {
+				int before = TourLength(list, tour, n);
+				ReverseRange(tour, a, b);
+				if (TourLength(list, tour, n) < before) {
+					improved = true;
+				} else {
+					ReverseRange(tour, a, b);
+				}
+			}
+		}
+	}
+
+	// With the neighbours fixed, move each closed loop's entry to the vertex nearest both of them.
+	for (int i = 0; i < n; i++) {
+		const Stroke* stroke = &list->strokes[tour[i].stroke];
+		if (!stroke->closed)
+			continue;
+		TourStep* prev = &tour[(i + n - 1) % n];
+		TourStep* next = &tour[(i + 1) % n];
+		int best_entry = tour[i].entry;
+		int best_length = StepJump(list, prev, &tour[i]) + StepJump(list, &tour[i], next);
+		for (int v = 0; v < stroke->num_vertices; v++) {
+			tour[i].entry = v;
+			int length = StepJump(list, prev, &tour[i]) + StepJump(list, &tour[i], next);
+			if (length < best_length) {
+				best_entry = v;
+				best_length = length;
+			}
+		}
+		tour[i].entry = best_entry;
+	}
+}
+
+static void DrawStep(Frame* frame, const Stroke* stroke, const TourStep* step)
+{
+	int n = stroke->num_vertices;
+	int entry = EntryVertex(stroke, step);
+	int steps = stroke->closed ? n : n - 1;
+
+	if (frame->x_start != stroke->x[entry] || frame->y_start != stroke->y[entry])
+		DrawLineTo(frame, stroke->x[entry], stroke->y[entry], 0);
+
+	for (int i = 1; i <= steps; i++) {
+		int v = step->reversed ? entry - i : entry + i;
+		v = ((v % n) + n) % n;
+		DrawLineTo(frame, stroke->x[v], stroke->y[v], stroke->color);
+	}
+}
+
+int DrawOptimizedPath(Frame* frame, const StrokeList* list)
+{
+	int n = list->num_strokes;
+	TourStep tour[MAX_STROKES];
+	TourStep best[MAX_STROKES];
+	int best_length = -1;
+
+	if (n == 0)
+		return frame->num_points - 1;
+
+	for (int first = 0; first < n; first++) {
+		GreedyTour(list, first, tour);
+		int length = TourLength(list, tour, n);
+		if (best_length < 0 || length < best_length) {
+			for (int i = 0; i < n; i++)
+				best[i] = tour[i];
+			best_length = length;
+		}
+	}
+	ImproveTour(list, best, n);
+
+	// The frame repeats, so start from where it ends; a stroke that picks up exactly there needs no hidden move.
+	const Stroke* last = &list->strokes[best[n - 1].stroke];
+	int exit = ExitVertex(last, &best[n - 1]);
+	frame->x_start = last->x[exit];
+	frame->y_start = last->y[exit];
+
+	for (int i = 0; i < n; i++)
+		DrawStep(frame, &list->strokes[best[i].stroke], &best[i]);
+
+	return frame->num_points - 1;
+}
@@ -0,0 +1,49 @@
+//Blanking path optimizer.  Works on the visible strokes of a frame (polylines between hidden
+//moves) and picks the stroke order, direction and, for closed loops, the entry vertex that
+//minimizes total blanked travel around the frame, which repeats cyclically on the DAC.
+//Strokes that end where the next one starts are joined without a hidden move.
+
+#include "main.h"
+
+#pragma once
+
+#define MAX_STROKE_VERTICES	16
+#define MAX_STROKES		48
+
+typedef struct
+{
+	int num_vertices;
+	int x[MAX_STROKE_VERTICES];
+	int y[MAX_STROKE_VERTICES];
+	int color;
+	bool closed;	//last vertex connects back to the first, which is not repeated
+} Stroke;
+
+typedef struct StrokeList
+{
+	int num_strokes;
+	Stroke strokes[MAX_STROKES];
+
+	//recording state, see StrokeRecorderLineTo
+	bool pen_down;
+} StrokeList;
+
+//Non-zero to build clock frames through DrawOptimizedPath, set with -optimize_path.
+extern int optimize_path;
+
+//Called by DrawLineTo while the frame's recorder is set, with the line from (x0,y0) to (x1,y1).
+void StrokeRecorderLineTo(StrokeList* list, int x0, int y0, int x1, int y1, int color);
+
+//Marks strokes whose last vertex returns to the first as closed.  Call after recording.
+void FinishStrokes(StrokeList* list);
+
+//Appends every stroke of src to dst, offset by (dx,dy).  Returns false if dst ran out of room.
+bool AppendStrokes(StrokeList* dst, const StrokeList* src, int dx, int dy);
+
+//X and Y galvos move at the same time, so a blank jump takes as long as its longer axis.
+//Returns the length of the jump from (x0,y0) to (x1,y1) in DAC units.
+int JumpLength(int x0, int y0, int x1, int y1);
+
+//Orders the strokes for minimum blanked travel and draws them into the frame with DrawLineTo.
+//Returns the index of the last point written.
+int DrawOptimizedPath(Frame* frame, const StrokeList* list);
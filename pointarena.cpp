@@ -0,0 +1,50 @@
+//Point arena, see pointarena.h
+
+#include "pointarena.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+//A free block holds the link to the next one in its first bytes.
+typedef union FreeBlock
+{
+	union FreeBlock* next;
+	HeliosDacClass::HeliosPoint points[MAX_POINTS];
+} FreeBlock;
+
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static FreeBlock* free_blocks = NULL;
+
+HeliosDacClass::HeliosPoint* ArenaAllocPoints()
+{
+	pthread_mutex_lock(&arena_lock);
+	if (free_blocks == NULL) {
+		// Slabs are never returned to the system; frames come and go but their number stays small.
+		FreeBlock* slab = (FreeBlock*)malloc(ARENA_SLAB_BLOCKS * sizeof(FreeBlock));
+		if (slab != NULL) {
+			for (int i = 0; i < ARENA_SLAB_BLOCKS; i++) {
+				slab[i].next = free_blocks;
+				free_blocks = &slab[i];
+			}
+		}
+	}
+
+	FreeBlock* block = free_blocks;
+	if (block != NULL)
+		free_blocks = block->next;
+	pthread_mutex_unlock(&arena_lock);
+
+	return block ? block->points : NULL;
+}
+
+void ArenaFreePoints(HeliosDacClass::HeliosPoint* points)
+{
+	if (points == NULL)
+		return;
+
+	FreeBlock* block = (FreeBlock*)points;
+
+	pthread_mutex_lock(&arena_lock);
+	block->next = free_blocks;
+	free_blocks = block;
+	pthread_mutex_unlock(&arena_lock);
+}
@@ -0,0 +1,15 @@
+//Point arena.  Frames get their point storage from here in blocks of MAX_POINTS, carved out of
+//a few large allocations and recycled through a free list, so a frame can be set up for another
+//render thread, DAC or zone, and let go again, without going back to malloc for each one.
+
+#include "main.h"
+
+#pragma once
+
+#define ARENA_SLAB_BLOCKS	4	//blocks allocated at a time
+
+//Returns a block of MAX_POINTS points, NULL if out of memory.  Safe to call from any thread.
+HeliosDacClass::HeliosPoint* ArenaAllocPoints();
+
+//Returns a block from ArenaAllocPoints to the arena.
+void ArenaFreePoints(HeliosDacClass::HeliosPoint* points);
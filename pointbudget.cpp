@@ -0,0 +1,236 @@
+//Automatic point budget, see pointbudget.h
+
+#include "pointbudget.h"
+#include "clockframe.h"
+#include <stdio.h>
+
+int auto_budget = 0;
+int target_fps = 0;
+int adapt_pps = 0;
+int max_pps = POINTS_PER_SECOND;
+
+//Settings from the command line, the finest the controller will use.
+static bool base_valid = false;
+static float base_divider;
+static int base_dwell;
+static int base_hidden_dwell;
+
+static int level = 0;
+static int reserved = 0;
+
+//Most points a frame has taken at each level, -1 if none was built at it yet, and how many
+//frames in a row have fit at the current level.
+static int worst[MAX_BUDGET_LEVEL + 1];
+static bool worst_valid = false;
+static int settled = 0;
+
+//Set once the frame was reported over budget at the coarsest settings, until it fits again.
+static bool warned_over = false;
+
+//Dwell counts are meant for POINTS_PER_SECOND; with adapt_pps they follow the frame's rate.
+static float dwell_scale = 1.0;
+
+//Fastest rate a frame is played at.
+static int MaxPointRate()
+{
+	if (!adapt_pps)
+		return POINTS_PER_SECOND;
+
+	int limit = (max_pps < HELIOS_MAX_RATE) ? max_pps : HELIOS_MAX_RATE;
+	return (limit > HELIOS_MIN_RATE) ? limit : HELIOS_MIN_RATE;
+}
+
+int FrameBudget()
+{
+	if (target_fps <= 0)
+		return MAX_PTS_FRAME;
+
+	int budget = MaxPointRate() / target_fps;
+	return budget < MAX_POINTS ? budget : MAX_POINTS;
+}
+
+void ReserveBudget(int points)
+{
+	reserved = points;
+}
+
+void BaseSettings(float* divider_out, int* dwell_out, int* hidden_dwell_out)
+{
+	*divider_out = base_valid ? base_divider : divider;
+	*dwell_out = base_valid ? base_dwell : dwell;
+	*hidden_dwell_out = base_valid ? base_hidden_dwell : hidden_dwell;
+}
+
+bool FitsWithMargin(int points, int budget)
+{
+	return points <= budget - budget * BUDGET_MARGIN_PERCENT / 100;
+}
+
+int PointBudgetLevel()
+{
+	return level;
+}
+
+int FramePointRate(int num_points)
+{
+	if (!adapt_pps || target_fps <= 0)
+		return POINTS_PER_SECOND;
+
+	long pps = (long)num_points * target_fps;
+	if (pps < HELIOS_MIN_RATE)
+		return HELIOS_MIN_RATE;
+	return (pps < MaxPointRate()) ? (int)pps : MaxPointRate();
+}
+
+void SetFrameRate(Frame* frame)
+{
+	frame->pps = FramePointRate(frame->num_points);
+
+	// The lines take pps / MaxPointRate() of the time per unit they would at the limit.
+	frame->brightness = adapt_pps ? (int)((long)FULL_BRIGHTNESS * frame->pps / MaxPointRate()) : FULL_BRIGHTNESS;
+}
+
+//Settings n steps coarser than the command line, with the dwell counts scaled by scale.
+static void ScaledSettings(int n, float scale, float* divider_out, int* dwell_out, int* hidden_dwell_out)
+{
+	float factor = 1.0 + 0.25 * n;
+	float finest_divider;
+	int finest_dwell, finest_hidden_dwell;
+
+	BaseSettings(&finest_divider, &finest_dwell, &finest_hidden_dwell);
+	*divider_out = finest_divider * factor;
+
+	*dwell_out = (int)(finest_dwell * scale / factor + 0.5);
+	if (*dwell_out < MIN_AUTO_DWELL && finest_dwell >= MIN_AUTO_DWELL)
+		*dwell_out = MIN_AUTO_DWELL;
+
+	*hidden_dwell_out = (int)(finest_hidden_dwell * scale / factor + 0.5);
+	if (*hidden_dwell_out < MIN_AUTO_HIDDEN_DWELL && finest_hidden_dwell >= MIN_AUTO_HIDDEN_DWELL)
+		*hidden_dwell_out = MIN_AUTO_HIDDEN_DWELL;
+}
+
+static void ApplyLevel(int n)
+{
+	ScaledSettings(n, dwell_scale, &divider, &dwell, &hidden_dwell);
+}
+
+void LevelSettings(int n, float* divider_out, int* dwell_out, int* hidden_dwell_out)
+{
+	ScaledSettings(n, 1.0, divider_out, dwell_out, hidden_dwell_out);
+}
+
+static void RecordWorst(int num_points)
+{
+	if (num_points > worst[level])
+		worst[level] = num_points;
+}
+
+//Scales the dwell counts to the rate the frame now plays at, rebuilding it if they change.
+static int AdaptDwell(ClockFrame* clock, const struct tm* tm, int rendered)
+{
+	float scale = FramePointRate(clock->frame.num_points) / (float)POINTS_PER_SECOND;
+
+	if (scale != dwell_scale) {
+		int old_dwell = dwell;
+		int old_hidden_dwell = hidden_dwell;
+
+		dwell_scale = scale;
+		ApplyLevel(level);
+		if (dwell != old_dwell || hidden_dwell != old_hidden_dwell)
+			rendered = BuildClockFrame(clock, tm);
+	}
+
+	SetFrameRate(&clock->frame);
+	return rendered;
+}
+
+int BuildBudgetedClockFrame(ClockFrame* clock, const struct tm* tm)
+{
+	if (!auto_budget && !adapt_pps)
+		return BuildClockFrame(clock, tm);
+
+	if (!base_valid) {
+		base_divider = divider;
+		base_dwell = dwell;
+		base_hidden_dwell = hidden_dwell;
+		base_valid = true;
+	}
+
+	if (!auto_budget) {
+		ApplyLevel(0);
+		return AdaptDwell(clock, tm, BuildClockFrame(clock, tm));
+	}
+
+	if (!worst_valid) {
+		for (int i = 0; i <= MAX_BUDGET_LEVEL; i++)
+			worst[i] = -1;
+		worst_valid = true;
+	}
+
+	int budget = FrameBudget() - reserved;
+	int previous = level;
+
+	ApplyLevel(level);
+	int rendered = BuildClockFrame(clock, tm);
+	RecordWorst(clock->frame.num_points);
+
+	while (clock->frame.num_points > budget && level < MAX_BUDGET_LEVEL) {
+		level++;
+		ApplyLevel(level);
+		rendered = BuildClockFrame(clock, tm);
+		RecordWorst(clock->frame.num_points);
+	}
+
+	settled = (level == previous && clock->frame.num_points <= budget) ? settled + 1 : 0;
+
+	// Step back towards the operator's settings one level at a time, once the frame has fit for
+	// a while and the finer level is expected to fit with room to spare.  The worst frame seen
+	// at it is the estimate; one never built at it is taken to grow as the settings scale it.
+	if (level > 0 && settled >= BUDGET_SETTLE_FRAMES) {
+		int expected = worst[level - 1];
+		if (expected < 0)
+			expected = (int)(clock->frame.num_points * (1.0 + 0.25 * level) / (1.0 + 0.25 * (level - 1)) + 0.5);
+
+		if (FitsWithMargin(expected, budget)) {
+			level--;
+			ApplyLevel(level);
+			rendered = BuildClockFrame(clock, tm);
+			RecordWorst(clock->frame.num_points);
+			if (clock->frame.num_points > budget) {
+				level++;
+				ApplyLevel(level);
+				rendered = BuildClockFrame(clock, tm);
+			}
+		}
+		settled = 0;
+	}
+
+	if (level != previous) {
+		fprintf(stderr, "Point budget %d: divider %.1f, dwell %d, hidden_dwell %d, %d points\n",
+				budget, divider, dwell, hidden_dwell, clock->frame.num_points);
+	}
+
+	bool over = clock->frame.num_points > budget && level == MAX_BUDGET_LEVEL;
+	if (over && !warned_over) {
+		fprintf(stderr, "Frame has %d points, over the budget of %d even at the coarsest settings.  Reduce size..\n",
+				clock->frame.num_points, budget);
+	}
+	warned_over = over;
+
+	return adapt_pps ? AdaptDwell(clock, tm, rendered) : rendered;
+}
+
+void ResetPointBudget()
+{
+	if (base_valid) {
+		divider = base_divider;
+		dwell = base_dwell;
+		hidden_dwell = base_hidden_dwell;
+	}
+	base_valid = false;
+	worst_valid = false;
+	level = 0;
+	settled = 0;
+	warned_over = false;
+	dwell_scale = 1.0;
+}
@@ -0,0 +1,72 @@
+//Automatic point budget.  Keeps each clock frame within the number of points the DAC can play
+//at the target refresh rate, by coarsening the interpolation divider and shortening the dwell
+//counts in steps, and restoring them once the frame fits again.
+//
+//With -adapt_pps each frame is instead played at the point rate that refreshes it at the target
+//rate, up to -max_pps, so a light frame like "11:11:11" flickers no less than "08:08:08".  The
+//dwell counts are scaled with the rate so the beam still holds each corner as long as it would at
+//POINTS_PER_SECOND.  The spacing of the points is left alone, so a frame played slower than
+//the limit has its lines drawn that much slower, and is dimmed by as much to look the same.
+
+#include "main.h"
+#include "clockframe.h"
+#include <time.h>
+
+#pragma once
+
+#define MAX_BUDGET_LEVEL	12	//divider up to 4x coarser, dwell down to 1/4
+#define MIN_AUTO_DWELL		2
+#define MIN_AUTO_HIDDEN_DWELL	5	//blank jumps still need time for the galvos to settle
+#define BUDGET_SETTLE_FRAMES	10	//frames in a row that must fit before a step back is tried
+#define BUDGET_MARGIN_PERCENT	8	//of the budget a step back must leave spare
+
+//Non-zero to enable the controller, set with -auto_budget.
+extern int auto_budget;
+
+//Target refresh rate in frames per second, set with -target_fps.
+//0 uses MAX_PTS_FRAME as the budget.
+extern int target_fps;
+
+//Non-zero to set each frame's point rate from its size, set with -adapt_pps.  Needs -target_fps.
+extern int adapt_pps;
+
+//Fastest point rate the galvos take, set with -max_pps.  Bounded by HELIOS_MAX_RATE.
+extern int max_pps;
+
+//Returns the number of points one frame may use.
+int FrameBudget();
+
+//Keeps points of the budget for other content in the frame, so BuildBudgetedClockFrame fits the
+//clock in FrameBudget() less them.  See compositor.h.
+void ReserveBudget(int points);
+
+//Gets divider, dwell and hidden_dwell as given on the command line, before any adjustment.
+void BaseSettings(float* divider_out, int* dwell_out, int* hidden_dwell_out);
+
+//Gets divider, dwell and hidden_dwell n steps coarser than the command line, as the controller
+//coarsens the clock, for content coarsened on its own.
+void LevelSettings(int n, float* divider_out, int* dwell_out, int* hidden_dwell_out);
+
+//Returns true if points fit in budget with BUDGET_MARGIN_PERCENT of it to spare, as a step back
+//towards finer settings must, so the next frame's digits do not push it straight back.
+bool FitsWithMargin(int points, int budget);
+
+//Returns how many steps coarser than the command line the controller has the clock now, 0 if none.
+int PointBudgetLevel();
+
+//Returns the point rate num_points are played at: POINTS_PER_SECOND, or with adapt_pps the rate
+//that plays them target_fps times a second, within HELIOS_MIN_RATE and max_pps.
+int FramePointRate(int num_points);
+
+//Sets the frame's pps and brightness for its number of points.
+void SetFrameRate(Frame* frame);
+
+//Builds the clock frame for tm with BuildClockFrame.  With auto_budget set, divider, dwell
+//and hidden_dwell are adjusted from the values given on the command line until the frame fits.
+//With adapt_pps dwell and hidden_dwell are scaled to the frame's point rate, which is set in it.
+//Returns the number of slots re-rendered by the final build.
+int BuildBudgetedClockFrame(ClockFrame* clock, const struct tm* tm);
+
+//Puts divider, dwell and hidden_dwell back to the values the controller started from and
+//forgets them, so the next BuildBudgetedClockFrame starts over from the current settings.
+void ResetPointBudget();
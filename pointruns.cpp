@@ -0,0 +1,54 @@
+//Run-length encoded points, see pointruns.h
+
+#include "pointruns.h"
+#include "linekernel.h"
+#include <string.h>
+
+static bool SamePoint(const HeliosDacClass::HeliosPoint* a, const HeliosDacClass::HeliosPoint* b)
+{
+	return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+int PointRunLength(const HeliosDacClass::HeliosPoint* points, int count)
+{
+	int n = 1;
+
+	while (n < count && n < MAX_RUN_COUNT && SamePoint(&points[n], &points[0]))
+		n++;
+	return n;
+}
+
+int EncodePointRuns(PointRun* runs, const HeliosDacClass::HeliosPoint* points, int count)
+{
+	int num_runs = 0;
+
+	for (int i = 0; i < count; ) {
+		int n = PointRunLength(&points[i], count - i);
+
+		runs[num_runs].point = points[i];
+		runs[num_runs].count = n;
+		num_runs++;
+		i += n;
+	}
+	return num_runs;
+}
+
+int RunPointCount(const PointRun* runs, int num_runs)
+{
+	int count = 0;
+
+	for (int i = 0; i < num_runs; i++)
+		count += runs[i].count;
+	return count;
+}
+
+int ExpandPointRuns(HeliosDacClass::HeliosPoint* out, const PointRun* runs, int num_runs, int max)
+{
+	int count = 0;
+
+	for (int i = 0; i < num_runs && count < max; i++) {
+		int n = (runs[i].count < max - count) ? runs[i].count : max - count;
+		count += FillPoints(&out[count], &runs[i].point, n);
+	}
+	return count;
+}
@@ -0,0 +1,30 @@
+//Run-length encoded points.  DrawLineTo holds the beam with dwell, and blank jumps with
+//hidden_dwell, copies of one point, so much of a frame is runs of the same point.  Where frames
+//are kept or sent on, in the glyph cache, the frame cache and the stream sink, they are stored as
+//(point, count) runs instead, and only expanded at the last stage: when a glyph is copied into a
+//frame, and when a frame is packed for the DAC or written to an ILDA file.
+
+#include "main.h"
+#include <stdint.h>
+
+#pragma once
+
+#define MAX_RUN_COUNT	0xFFFF
+
+typedef struct PointRun
+{
+	HeliosDacClass::HeliosPoint point;
+	uint16_t count;
+} PointRun;
+
+//Returns how many of the count points, from the first, are the same point, up to MAX_RUN_COUNT.
+int PointRunLength(const HeliosDacClass::HeliosPoint* points, int count);
+
+//Encodes count points as runs of equal points.  Returns the number of runs, at most count.
+int EncodePointRuns(PointRun* runs, const HeliosDacClass::HeliosPoint* points, int count);
+
+//Returns the number of points the runs expand to.
+int RunPointCount(const PointRun* runs, int num_runs);
+
+//Expands the runs into out, stopping after max points.  Returns the number of points written.
+int ExpandPointRuns(HeliosDacClass::HeliosPoint* out, const PointRun* runs, int num_runs, int max);
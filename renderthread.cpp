@@ -0,0 +1,92 @@
+//Ahead-of-time rendering, see renderthread.h
+
+#include "renderthread.h"
+#include "compositor.h"
+#include "stats.h"
+#include <pthread.h>
+#include <stdio.h>
+
+int render_ahead = 0;
+
+static pthread_mutex_t render_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t render_cond = PTHREAD_COND_INITIALIZER;
+static ClockFrame* render_target = NULL;	//queued, or being rendered
+static time_t render_time = 0;
+static bool render_done = true;
+
+void RenderClockFrame(ClockFrame* clock, time_t t)
+{
+	static bool overflow = false;	//last reported
+	struct tm tm;
+
+	localtime_r(&t, &tm);
+
+	// Only the slots from the first changed digit on are re-rendered, from the glyph cache,
+	// and only zones whose text changed are drawn again.
+	ComposeClockFrame(clock, &tm, t);
+	ReportClipping();
+	StatsFrameRendered(clock->frame.num_points, clock->frame.overflow);
+
+	if (clock->frame.overflow != overflow) {
+		if (clock->frame.overflow)
+			fprintf(stderr, "Frame is over %d points, the rest is not drawn.  Reduce size or dwell..\n", clock->frame.capacity);
+		overflow = clock->frame.overflow;
+	}
+}
+
+static void* RenderThread(void* arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&render_lock);
+	while (1) {
+		while (render_target == NULL)
+			pthread_cond_wait(&render_cond, &render_lock);
+
+		ClockFrame* clock = render_target;
+		time_t t = render_time;
+		pthread_mutex_unlock(&render_lock);
+
+		RenderClockFrame(clock, t);
+
+		pthread_mutex_lock(&render_lock);
+		render_target = NULL;
+		render_done = true;
+		pthread_cond_broadcast(&render_cond);
+	}
+
+	return NULL;
+}
+
+int StartRenderThread()
+{
+	pthread_t thread;
+
+	if (pthread_create(&thread, NULL, RenderThread, NULL) != 0) {
+		fprintf(stderr, "Could not start the render thread..\n");
+		return 0;
+	}
+	pthread_detach(thread);
+	return 1;
+}
+
+void QueueRender(ClockFrame* clock, time_t t)
+{
+	pthread_mutex_lock(&render_lock);
+	render_target = clock;
+	render_time = t;
+	render_done = false;
+	pthread_cond_broadcast(&render_cond);
+	pthread_mutex_unlock(&render_lock);
+}
+
+time_t WaitRender()
+{
+	pthread_mutex_lock(&render_lock);
+	while (!render_done)
+		pthread_cond_wait(&render_cond, &render_lock);
+	time_t t = render_time;
+	pthread_mutex_unlock(&render_lock);
+
+	return t;
+}
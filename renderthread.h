@@ -0,0 +1,25 @@
+//Ahead-of-time rendering.  A producer thread renders the clock frame for the coming second into
+//a back buffer while the output loop keeps the DAC fed from the front buffer, so the new frame is
+//ready to send as soon as the second changes.
+
+#include "main.h"
+#include "clockframe.h"
+#include <time.h>
+
+#pragma once
+
+//Non-zero to render on the producer thread, set with -render_ahead.
+extern int render_ahead;
+
+//Renders the clock frame for wall clock time t, within the point budget, and reports clipping.
+void RenderClockFrame(ClockFrame* clock, time_t t);
+
+//Starts the producer thread.  Returns 1 if successful.
+int StartRenderThread();
+
+//Hands a back buffer to the producer thread to render for time t.
+//The buffer must not be touched until WaitRender returns.
+void QueueRender(ClockFrame* clock, time_t t);
+
+//Blocks until the frame passed to QueueRender is rendered.  Returns the time it was rendered for.
+time_t WaitRender();
@@ -0,0 +1,62 @@
+//Real-time output, see rtmode.h
+
+#include "rtmode.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int rt_priority = 0;
+int rt_cpu = -1;
+
+void LockMemory()
+{
+	if (rt_priority <= 0)
+		return;
+
+	// MCL_FUTURE covers the output thread stacks and anything allocated once they run.
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		fprintf(stderr, "Could not lock memory (%s), pages may still fault on output..\n", strerror(errno));
+}
+
+void PrefaultMemory(void* buffer, size_t size)
+{
+	if (rt_priority <= 0 && rt_cpu < 0)
+		return;
+
+	// One write a page is enough; a fresh allocation may not be backed until each is touched.
+	long page = sysconf(_SC_PAGESIZE);
+	if (page <= 0)
+		page = 4096;
+	volatile char* bytes = (volatile char*)buffer;
+	for (size_t i = 0; i < size; i += page)
+		bytes[i] = bytes[i];
+	if (size > 0)
+		bytes[size - 1] = bytes[size - 1];
+}
+
+void MakeOutputThreadRealtime(pthread_t thread, const char* name)
+{
+	if (rt_priority > 0) {
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = (rt_priority > MAX_RT_PRIORITY) ? MAX_RT_PRIORITY : rt_priority;
+		int error = pthread_setschedparam(thread, SCHED_FIFO, &param);
+		if (error != 0)
+			fprintf(stderr, "Could not run the output for %s at real-time priority %d (%s)..\n", name, param.sched_priority, strerror(error));
+	}
+
+	if (rt_cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		int error = EINVAL;
+		if (rt_cpu < CPU_SETSIZE) {
+			CPU_SET(rt_cpu, &cpus);
+			error = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+		}
+		if (error != 0)
+			fprintf(stderr, "Could not pin the output for %s to CPU %d (%s)..\n", name, rt_cpu, strerror(error));
+	}
+}
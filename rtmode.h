@@ -0,0 +1,39 @@
+//Real-time output.  On a loaded machine the threads feeding the DACs can be preempted between
+//the DAC reporting ready and the next frame going out, and a DAC left waiting runs dry or loops
+//its old frame, which shows as a stutter at the second change.  -rt_priority N runs the DAC
+//output threads SCHED_FIFO at priority N, ahead of everything at normal priority, and locks the
+//process's memory with mlockall, so neither they nor the frames they pack take a page fault on
+//the way to the DAC.  The output buffers are touched once as they are allocated, so they are
+//faulted in before the first frame rather than during it, with or without the lock.  -rt_cpu N
+//pins the output threads to CPU N, best one kept free of other work with isolcpus.
+//
+//Both need root, or CAP_SYS_NICE and CAP_IPC_LOCK with a high enough memlock limit.  What cannot
+//be set is reported and the clock carries on without it.  Whether it helps shows in the
+//ready to submit times, which -jitter_interval prints and the stats file carries (see stats.h).
+//With -frame_cache the lock includes the whole mapped cache file.
+
+#include "main.h"
+#include <pthread.h>
+#include <stddef.h>
+
+#pragma once
+
+#define MAX_RT_PRIORITY	99
+
+//SCHED_FIFO priority of the DAC output threads, set with -rt_priority.  0 leaves them at
+//normal priority and memory unlocked.
+extern int rt_priority;
+
+//CPU to pin the DAC output threads to, set with -rt_cpu.  -1 lets them run on any.
+extern int rt_cpu;
+
+//With -rt_priority locks the process's memory, current and future.  Call it once, before the
+//output threads start.
+void LockMemory();
+
+//With -rt_priority or -rt_cpu touches every page of a buffer the output threads use, so it is
+//in memory before they start.
+void PrefaultMemory(void* buffer, size_t size);
+
+//Applies -rt_priority and -rt_cpu to a DAC output thread just started, named for the messages.
+void MakeOutputThreadRealtime(pthread_t thread, const char* name);
@@ -0,0 +1,116 @@
+//Output scheduling, see scheduler.h
+
+#include "scheduler.h"
+#include "stats.h"
+#include <strings.h>
+
+int sched_mode = SCHED_SPIN;
+
+// Interval between GetStatus polls in sleep mode, in microseconds.
+// Short compared to a frame (~30ms at 1000 points and 30K pps), so a ready DAC is not left idle for long.
+int poll_us = 1000;
+
+int ParseSchedMode(const char* name)
+{
+	if (strcasecmp(name, "spin") == 0)
+		return SCHED_SPIN;
+	if (strcasecmp(name, "sleep") == 0)
+		return SCHED_SLEEP;
+	return -1;
+}
+
+struct timespec NextSecondEdge(time_t t)
+{
+	struct timespec edge;
+
+	edge.tv_sec = t + 1;
+	edge.tv_nsec = 0;
+	return edge;
+}
+
+static bool TimespecBefore(const struct timespec* a, const struct timespec* b)
+{
+	if (a->tv_sec != b->tv_sec)
+		return a->tv_sec < b->tv_sec;
+	return a->tv_nsec < b->tv_nsec;
+}
+
+bool DeadlineReached(const struct timespec* deadline)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	return !TimespecBefore(&now, deadline);
+}
+
+//Sleeps for one poll interval, or until the deadline if that comes first.
+static void SleepPollInterval(const struct timespec* deadline)
+{
+	struct timespec wake;
+	int interval = poll_us;
+
+	if (interval < MIN_POLL_US) interval = MIN_POLL_US;
+	if (interval > MAX_POLL_US) interval = MAX_POLL_US;
+
+	clock_gettime(CLOCK_REALTIME, &wake);
+	wake.tv_nsec += interval * 1000L;
+	if (wake.tv_nsec >= 1000000000L) {
+		wake.tv_sec++;
+		wake.tv_nsec -= 1000000000L;
+	}
+
+	if (TimespecBefore(deadline, &wake))
+		wake = *deadline;
+
+	// An early wakeup (EINTR) only costs an extra poll.
+	clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &wake, NULL);
+}
+
+void SleepUntil(const struct timespec* deadline)
+{
+	if (sched_mode == SCHED_SLEEP) {
+		while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, deadline, NULL) != 0)
+			;
+		return;
+	}
+
+	while (!DeadlineReached(deadline))
+		;
+}
+
+static int PollDac(HeliosDacClass& helios, int dacNum, const struct timespec* deadline, int* polls)
+{
+	while (1) {
+		int status = helios.GetStatus(dacNum);
+		(*polls)++;
+
+		if (status == 1)
+			return 1;
+
+		if (sched_mode == SCHED_SLEEP) {
+			// Back off on failures too, rather than hammering a device that is not answering.
+			SleepPollInterval(deadline);
+			if (status < 0)
+				return -1;
+		} else if (status < 0) {
+			return -1;
+		}
+
+		if (DeadlineReached(deadline))
+			return 0;
+	}
+}
+
+int WaitForDac(HeliosDacClass& helios, int dacNum, const struct timespec* deadline, struct timespec* ready)
+{
+	struct timespec start, end;
+	int polls = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int status = PollDac(helios, dacNum, deadline, &polls);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	StatsDacPoll(dacNum, polls, (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec));
+	*ready = end;
+	return status;
+}
@@ -0,0 +1,34 @@
+//Output scheduling.  Decides how the main loop waits for the DAC to become ready and for the
+//next second to start: either busy-spinning on GetStatus, or sleeping on CLOCK_REALTIME and
+//polling the DAC at a bounded interval.
+
+#include "main.h"
+#include <time.h>
+
+#pragma once
+
+#define SCHED_SPIN	0	//poll GetStatus back to back, lowest latency, uses a full core
+#define SCHED_SLEEP	1	//sleep between polls, near zero CPU
+
+#define MIN_POLL_US	50
+#define MAX_POLL_US	100000
+
+extern int sched_mode;
+extern int poll_us;
+
+//Parses the -sched argument ("spin" or "sleep").  Returns SCHED_SPIN or SCHED_SLEEP, -1 if unknown.
+int ParseSchedMode(const char* name);
+
+//Returns the start of the second following t on CLOCK_REALTIME.
+struct timespec NextSecondEdge(time_t t);
+
+//Returns true once CLOCK_REALTIME has reached the deadline.
+bool DeadlineReached(const struct timespec* deadline);
+
+//Waits until CLOCK_REALTIME reaches the deadline, spinning or sleeping according to sched_mode.
+void SleepUntil(const struct timespec* deadline);
+
+//Waits until the DAC is ready for a frame or the deadline passes, according to sched_mode.
+//Returns 1 if the DAC is ready, set in ready on CLOCK_MONOTONIC, 0 if the deadline passed
+//first, -1 if communication failed.
+int WaitForDac(HeliosDacClass& helios, int dacNum, const struct timespec* deadline, struct timespec* ready);
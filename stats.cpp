@@ -0,0 +1,365 @@
+//Runtime statistics, see stats.h
+
+#include "stats.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+
+const char* stats_file = NULL;
+int stats_interval = STATS_DEFAULT_INTERVAL;
+int jitter_interval = 0;
+
+typedef struct
+{
+	unsigned long long frames;
+	unsigned long long parts;	//DAC frames, more than frames while they are played in parts
+	unsigned long long points;
+	unsigned long long send_errors;
+	unsigned long long truncated;
+	unsigned long long keepalives;
+	unsigned long long keepalive_failures;
+	unsigned long long polls;
+	long long poll_wait_ns;
+	unsigned long long latency[STATS_LATENCY_BUCKETS];
+	long long latency_ns;	//sum of all send times
+	unsigned long long gap[STATS_GAP_BUCKETS];
+	long long gap_ns;	//sum of all ready to submit times
+	long gap_max_ns;
+} DacStats;
+
+typedef struct
+{
+	unsigned long long rendered;
+	int last_points;
+	unsigned long long overflows;
+	unsigned long long published;
+	unsigned long long late;
+	long last_lag_ns;
+	unsigned long long render_misses;
+	unsigned long long skipped;
+	DacStats dacs[HELIOS_MAX_DEVICES];
+	int num_dacs;	//highest DAC seen + 1
+} Stats;
+
+// Updated from the render loop and every DAC output thread.
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static Stats stats;
+
+static DacStats* Dac(int dacNum)
+{
+	if (dacNum < 0 || dacNum >= HELIOS_MAX_DEVICES)
+		return NULL;
+	if (dacNum >= stats.num_dacs)
+		stats.num_dacs = dacNum + 1;
+	return &stats.dacs[dacNum];
+}
+
+void StatsFrameRendered(int num_points, bool overflow)
+{
+	pthread_mutex_lock(&stats_lock);
+	stats.rendered++;
+	stats.last_points = num_points;
+	if (overflow)
+		stats.overflows++;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void StatsFramePublished(long lag_ns, bool late)
+{
+	pthread_mutex_lock(&stats_lock);
+	stats.published++;
+	stats.last_lag_ns = lag_ns;
+	if (late)
+		stats.late++;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void StatsRenderMiss()
+{
+	pthread_mutex_lock(&stats_lock);
+	stats.render_misses++;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void StatsSkippedSeconds(int count)
+{
+	pthread_mutex_lock(&stats_lock);
+	stats.skipped += count;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void StatsDacPoll(int dacNum, int polls, long wait_ns)
+{
+	pthread_mutex_lock(&stats_lock);
+	DacStats* dac = Dac(dacNum);
+	if (dac) {
+		dac->polls += polls;
+		dac->poll_wait_ns += wait_ns;
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+//Bucket b holds the times up to 2^(b/4) us, the last one everything longer.
+static double GapBound(int bucket)
+{
+	return pow(2.0, bucket / 4.0) * 1e-6;
+}
+
+void StatsReadyToSubmit(int dacNum, const struct timespec* ready)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long gap_ns = (now.tv_sec - ready->tv_sec) * 1000000000L + (now.tv_nsec - ready->tv_nsec);
+	if (gap_ns < 0)
+		gap_ns = 0;
+
+	int bucket = (gap_ns <= 1000) ? 0 : (int)ceil(4.0 * log2(gap_ns * 1e-3));
+	if (bucket > STATS_GAP_BUCKETS - 1)
+		bucket = STATS_GAP_BUCKETS - 1;
+
+	pthread_mutex_lock(&stats_lock);
+	DacStats* dac = Dac(dacNum);
+	if (dac) {
+		dac->gap[bucket]++;
+		dac->gap_ns += gap_ns;
+		if (gap_ns > dac->gap_max_ns)
+			dac->gap_max_ns = gap_ns;
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void StatsFrameSent(int dacNum, const WireFrame* wire, long send_ns, bool ok)
+{
+	pthread_mutex_lock(&stats_lock);
+	DacStats* dac = Dac(dacNum);
+	if (dac && !ok) {
+		dac->send_errors++;
+	} else if (dac) {
+		if (wire->part == 0)
+			dac->frames++;
+		dac->parts++;
+		dac->points += wire->num_points;
+		dac->latency_ns += send_ns;
+
+		int bucket = 0;
+		long bound = 250000;
+		while (bucket < STATS_LATENCY_BUCKETS - 1 && send_ns > bound) {
+			bucket++;
+			bound *= 2;
+		}
+		dac->latency[bucket]++;
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void StatsFrameTruncated(int dacNum)
+{
+	pthread_mutex_lock(&stats_lock);
+	DacStats* dac = Dac(dacNum);
+	if (dac)
+		dac->truncated++;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void StatsKeepalive(int dacNum, bool ok)
+{
+	pthread_mutex_lock(&stats_lock);
+	DacStats* dac = Dac(dacNum);
+	if (dac) {
+		dac->keepalives++;
+		if (!ok)
+			dac->keepalive_failures++;
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+static unsigned long long GapCount(const DacStats* dac)
+{
+	unsigned long long count = 0;
+	for (int b = 0; b < STATS_GAP_BUCKETS; b++)
+		count += dac->gap[b];
+	return count;
+}
+
+//Returns the q quantile of the DAC's ready to submit times in seconds, as the upper bound of its
+//bucket but never beyond the max.
+static double GapQuantile(const DacStats* dac, double q)
+{
+	unsigned long long count = GapCount(dac);
+	unsigned long long rank = (unsigned long long)ceil(q * count);
+	unsigned long long seen = 0;
+	double max = dac->gap_max_ns * 1e-9;
+
+	for (int b = 0; b < STATS_GAP_BUCKETS - 1; b++) {
+		seen += dac->gap[b];
+		if (seen >= rank && seen > 0)
+			return (GapBound(b) < max) ? GapBound(b) : max;
+	}
+	return max;
+}
+
+static void WriteCounter(FILE* f, const char* name, const char* help, unsigned long long value)
+{
+	fprintf(f, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name, value);
+}
+
+static void WriteGauge(FILE* f, const char* name, const char* help, double value)
+{
+	fprintf(f, "# HELP %s %s\n# TYPE %s gauge\n%s %g\n", name, help, name, name, value);
+}
+
+static void WriteStats(FILE* f, const Stats* s, const double* fps, double uptime)
+{
+	WriteGauge(f, "laserclock_uptime_seconds", "Seconds since the clock started.", uptime);
+	WriteCounter(f, "laserclock_frames_rendered_total", "Clock frames rendered.", s->rendered);
+	WriteGauge(f, "laserclock_frame_points", "Points in the last frame rendered.", s->last_points);
+	WriteCounter(f, "laserclock_frame_overflows_total", "Frames cut short at MAX_POINTS.", s->overflows);
+	WriteCounter(f, "laserclock_frames_published_total", "New frames handed to the DACs.", s->published);
+	WriteCounter(f, "laserclock_frames_late_total", "Frames that reached the DACs too late for their second edge.", s->late);
+	WriteGauge(f, "laserclock_publish_lag_seconds", "Time from the second edge to publishing its frame, last frame.", s->last_lag_ns * 1e-9);
+	WriteCounter(f, "laserclock_render_misses_total", "Frames rendered ahead for the wrong second.", s->render_misses);
+	WriteCounter(f, "laserclock_seconds_skipped_total", "Seconds the display jumped over.", s->skipped);
+
+	// Per DAC series, one sample per DAC under each metric.
+	fprintf(f, "# HELP laserclock_dac_fps Frames per second sent to the DAC over the last interval.\n# TYPE laserclock_dac_fps gauge\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_fps{dac=\"%d\"} %g\n", i, fps[i]);
+	fprintf(f, "# HELP laserclock_dac_frames_total Frames sent to the DAC.\n# TYPE laserclock_dac_frames_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_frames_total{dac=\"%d\"} %llu\n", i, s->dacs[i].frames);
+	fprintf(f, "# HELP laserclock_dac_parts_total DAC frames sent, each part of a frame played in parts counted.\n# TYPE laserclock_dac_parts_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_parts_total{dac=\"%d\"} %llu\n", i, s->dacs[i].parts);
+	fprintf(f, "# HELP laserclock_dac_points_total Points sent to the DAC.\n# TYPE laserclock_dac_points_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_points_total{dac=\"%d\"} %llu\n", i, s->dacs[i].points);
+	fprintf(f, "# HELP laserclock_dac_send_errors_total Frames that failed to send.\n# TYPE laserclock_dac_send_errors_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_send_errors_total{dac=\"%d\"} %llu\n", i, s->dacs[i].send_errors);
+	fprintf(f, "# HELP laserclock_dac_truncated_total Frames cut short, over MAX_WIRE_CHUNKS DAC frames.\n# TYPE laserclock_dac_truncated_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_truncated_total{dac=\"%d\"} %llu\n", i, s->dacs[i].truncated);
+	fprintf(f, "# HELP laserclock_dac_keepalives_total Status checks of a DAC looping its frame.\n# TYPE laserclock_dac_keepalives_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_keepalives_total{dac=\"%d\"} %llu\n", i, s->dacs[i].keepalives);
+	fprintf(f, "# HELP laserclock_dac_keepalive_failures_total Status checks the DAC did not answer.\n# TYPE laserclock_dac_keepalive_failures_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_keepalive_failures_total{dac=\"%d\"} %llu\n", i, s->dacs[i].keepalive_failures);
+	fprintf(f, "# HELP laserclock_dac_status_polls_total Status polls of the DAC.\n# TYPE laserclock_dac_status_polls_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_status_polls_total{dac=\"%d\"} %llu\n", i, s->dacs[i].polls);
+	fprintf(f, "# HELP laserclock_dac_status_wait_seconds_total Time spent waiting for the DAC to become ready.\n# TYPE laserclock_dac_status_wait_seconds_total counter\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_status_wait_seconds_total{dac=\"%d\"} %.6f\n", i, s->dacs[i].poll_wait_ns * 1e-9);
+
+	fprintf(f, "# HELP laserclock_dac_send_seconds Time to send a frame to the DAC.\n# TYPE laserclock_dac_send_seconds histogram\n");
+	for (int i = 0; i < s->num_dacs; i++) {
+		const DacStats* dac = &s->dacs[i];
+		unsigned long long total = 0;
+		double bound = 250e-6;
+		for (int b = 0; b < STATS_LATENCY_BUCKETS; b++) {
+			total += dac->latency[b];
+			if (b < STATS_LATENCY_BUCKETS - 1)
+				fprintf(f, "laserclock_dac_send_seconds_bucket{dac=\"%d\",le=\"%g\"} %llu\n", i, bound, total);
+			else
+				fprintf(f, "laserclock_dac_send_seconds_bucket{dac=\"%d\",le=\"+Inf\"} %llu\n", i, total);
+			bound *= 2;
+		}
+		fprintf(f, "laserclock_dac_send_seconds_sum{dac=\"%d\"} %.6f\n", i, dac->latency_ns * 1e-9);
+		fprintf(f, "laserclock_dac_send_seconds_count{dac=\"%d\"} %llu\n", i, total);
+	}
+
+	fprintf(f, "# HELP laserclock_dac_ready_to_submit_seconds Time from the DAC reporting ready to submitting the next frame to it.\n# TYPE laserclock_dac_ready_to_submit_seconds summary\n");
+	for (int i = 0; i < s->num_dacs; i++) {
+		const DacStats* dac = &s->dacs[i];
+		fprintf(f, "laserclock_dac_ready_to_submit_seconds{dac=\"%d\",quantile=\"0.5\"} %g\n", i, GapQuantile(dac, 0.5));
+		fprintf(f, "laserclock_dac_ready_to_submit_seconds{dac=\"%d\",quantile=\"0.99\"} %g\n", i, GapQuantile(dac, 0.99));
+		fprintf(f, "laserclock_dac_ready_to_submit_seconds_sum{dac=\"%d\"} %.6f\n", i, dac->gap_ns * 1e-9);
+		fprintf(f, "laserclock_dac_ready_to_submit_seconds_count{dac=\"%d\"} %llu\n", i, GapCount(dac));
+	}
+	fprintf(f, "# HELP laserclock_dac_ready_to_submit_max_seconds Longest time from the DAC reporting ready to submitting the next frame to it.\n# TYPE laserclock_dac_ready_to_submit_max_seconds gauge\n");
+	for (int i = 0; i < s->num_dacs; i++)
+		fprintf(f, "laserclock_dac_ready_to_submit_max_seconds{dac=\"%d\"} %g\n", i, s->dacs[i].gap_max_ns * 1e-9);
+}
+
+//Prints each DAC's ready to submit times so far.
+static void ReportJitter(const Stats* s)
+{
+	for (int i = 0; i < s->num_dacs; i++) {
+		const DacStats* dac = &s->dacs[i];
+		unsigned long long count = GapCount(dac);
+		if (count == 0)
+			continue;
+		fprintf(stderr, "DAC %d ready to submit: p50 %.0f us, p99 %.0f us, max %.0f us over %llu frames\n", i,
+				GapQuantile(dac, 0.5) * 1e6, GapQuantile(dac, 0.99) * 1e6, dac->gap_max_ns * 1e-3, count);
+	}
+}
+
+static double Seconds(const struct timespec* t)
+{
+	return t->tv_sec + t->tv_nsec * 1e-9;
+}
+
+void WriteStatsIfDue()
+{
+	static bool started = false;
+	static struct timespec start, last_write, last_report;
+	static unsigned long long last_frames[HELIOS_MAX_DEVICES];
+	static bool warned = false;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!started) {
+		start = last_write = last_report = now;
+		started = true;
+	}
+
+	// Work from a copy, so the output threads are not held up by the file write.
+	static Stats snapshot;
+	if (jitter_interval > 0 && Seconds(&now) - Seconds(&last_report) >= jitter_interval) {
+		pthread_mutex_lock(&stats_lock);
+		snapshot = stats;
+		pthread_mutex_unlock(&stats_lock);
+		ReportJitter(&snapshot);
+		last_report = now;
+	}
+
+	if (stats_file == NULL)
+		return;
+
+	double elapsed = Seconds(&now) - Seconds(&last_write);
+	if (elapsed < (stats_interval > 0 ? stats_interval : 1))
+		return;
+
+	pthread_mutex_lock(&stats_lock);
+	snapshot = stats;
+	pthread_mutex_unlock(&stats_lock);
+
+	double fps[HELIOS_MAX_DEVICES];
+	for (int i = 0; i < snapshot.num_dacs; i++) {
+		fps[i] = (snapshot.dacs[i].frames - last_frames[i]) / elapsed;
+		last_frames[i] = snapshot.dacs[i].frames;
+	}
+	last_write = now;
+
+	char temp[1024];
+	snprintf(temp, sizeof(temp), "%s.tmp", stats_file);
+	FILE* f = fopen(temp, "w");
+	if (f == NULL) {
+		if (!warned) {
+			fprintf(stderr, "Could not write stats file %s..\n", temp);
+			warned = true;
+		}
+		return;
+	}
+	WriteStats(f, &snapshot, fps, Seconds(&now) - Seconds(&start));
+	bool ok = fclose(f) == 0;
+
+	if (!ok || rename(temp, stats_file) != 0) {
+		if (!warned) {
+			fprintf(stderr, "Could not write stats file %s..\n", stats_file);
+			warned = true;
+		}
+		remove(temp);
+	}
+}
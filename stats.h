@@ -0,0 +1,61 @@
+//Runtime statistics.  The render loop and the DAC output threads count what they do, and the
+//counters are written every -stats_interval seconds to the file given with -stats_file, in the
+//Prometheus text format so it can be scraped as is (for example by the node_exporter textfile
+//collector).  The file is rewritten through a temporary file and a rename, so a reader never
+//sees half of it.
+//
+//For each DAC the time from it reporting ready to the next frame being submitted to it is kept
+//too, in buckets a quarter of an octave wide from 1 us, so its p50 and p99 are known to within
+//a fifth and its max exactly.  With -jitter_interval they are also printed to stderr.
+
+#include "main.h"
+#include "wireframe.h"
+#include <time.h>
+
+#pragma once
+
+#define STATS_LATENCY_BUCKETS	10	//send time histogram, 250 us doubling up to 64 ms, then the rest
+#define STATS_GAP_BUCKETS	80	//ready to submit histogram, 1 us up by 2^(1/4) to 0.7 s, then the rest
+#define STATS_DEFAULT_INTERVAL	10
+
+//File to write, set with -stats_file.  NULL writes nothing.
+extern const char* stats_file;
+
+//Seconds between rewrites of the stats file, set with -stats_interval.
+extern int stats_interval;
+
+//Seconds between printing the ready to submit times, set with -jitter_interval.  0 for never.
+extern int jitter_interval;
+
+//A clock frame was rendered.  overflow is true if it ran out of room and points were dropped.
+void StatsFrameRendered(int num_points, bool overflow);
+
+//A new frame was published, lag_ns after the second edge it is for (negative when ahead of it).
+//late is true if it reached the DACs too late to change the display on time.
+void StatsFramePublished(long lag_ns, bool late);
+
+//The frame rendered ahead was for the wrong second and had to be rendered late.
+void StatsRenderMiss();
+
+//The displayed time jumped over count seconds.
+void StatsSkippedSeconds(int count);
+
+//The DAC was polled polls times before reporting ready, over wait_ns.
+void StatsDacPoll(int dacNum, int polls, long wait_ns);
+
+//The DAC reported ready at ready, on CLOCK_MONOTONIC, and a frame is being submitted to it now.
+void StatsReadyToSubmit(int dacNum, const struct timespec* ready);
+
+//The wire frame was sent to the DAC in send_ns, or failed to send.  Of a frame played in parts,
+//each part counts as a DAC frame and the first as the frame.
+void StatsFrameSent(int dacNum, const WireFrame* wire, long send_ns, bool ok);
+
+//A frame was cut short for the DAC, over MAX_WIRE_CHUNKS frames of HELIOS_MAX_POINTS.
+void StatsFrameTruncated(int dacNum);
+
+//A DAC left to loop its frame with -send_on_change was checked, and answered if ok.
+void StatsKeepalive(int dacNum, bool ok);
+
+//Rewrites the stats file and prints the ready to submit times if they are due.  Called once a
+//second from the render loop.
+void WriteStatsIfDue();
@@ -0,0 +1,352 @@
+//Stroke font, see strokefont.h
+
+#include "strokefont.h"
+
+enum
+{
+	PEN_UP,		//blank move to the vertex
+	PEN_DOWN,	//visible line to the vertex
+	GLYPH,		//starts the character in x, not a vertex
+	SEGMENTS,	//the character in x, drawn as the 7-segment display segments in y
+};
+
+//Coordinates are in half sizes from the cell origin, x towards x+size and y towards y-2*size,
+//so (2,4) is the far corner of a digit.
+typedef struct
+{
+	unsigned char x;
+	unsigned char y;
+	unsigned char pen;
+} FontVertex;
+
+//The segments of a 7-segment display, as they are usually lettered.
+#define SEG_A		0x01	//top
+#define SEG_B		0x02	//upper right
+#define SEG_C		0x04	//lower right
+#define SEG_D		0x08	//bottom
+#define SEG_E		0x10	//lower left
+#define SEG_F		0x20	//upper left
+#define SEG_G		0x40	//middle
+#define SEG_SETTLE	0x80	//not a segment: the first move is made twice, the extra dwell sharpens the character
+
+#define CHAR(c)			{ c, 0, GLYPH }
+#define SEGMENT_CHAR(c, s)	{ c, s, SEGMENTS }
+#define UP(x, y)		{ x, y, PEN_UP }
+#define DOWN(x, y)		{ x, y, PEN_DOWN }
+
+static constexpr FontVertex outline[] = {
+	SEGMENT_CHAR('0', SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F),
+	SEGMENT_CHAR('1', SEG_B | SEG_C | SEG_SETTLE),
+	SEGMENT_CHAR('2', SEG_A | SEG_B | SEG_G | SEG_E | SEG_D),
+	SEGMENT_CHAR('3', SEG_A | SEG_B | SEG_G | SEG_C | SEG_D),
+	SEGMENT_CHAR('4', SEG_F | SEG_G | SEG_B | SEG_C),
+	SEGMENT_CHAR('5', SEG_A | SEG_F | SEG_G | SEG_C | SEG_D),
+	SEGMENT_CHAR('6', SEG_A | SEG_F | SEG_E | SEG_D | SEG_C | SEG_G),
+	SEGMENT_CHAR('7', SEG_A | SEG_B | SEG_C),
+	SEGMENT_CHAR('8', SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G),
+	SEGMENT_CHAR('9', SEG_A | SEG_B | SEG_C | SEG_F | SEG_G),
+
+	// Date and time separators.
+	CHAR(':'), UP(1,1), DOWN(1,1), UP(1,3), DOWN(1,3),
+	CHAR('.'), UP(1,4), DOWN(1,4),
+	SEGMENT_CHAR('-', SEG_G),
+	CHAR('/'), UP(0,4), DOWN(2,0),
+
+	// Hex digits and the other letters a 7-segment display can show, the lower case shapes
+	// where the upper case would be taken for a digit.  AM/PM too, 'M' with its diagonals.
+	SEGMENT_CHAR('A', SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G),
+	SEGMENT_CHAR('B', SEG_C | SEG_D | SEG_E | SEG_F | SEG_G),
+	SEGMENT_CHAR('C', SEG_A | SEG_D | SEG_E | SEG_F),
+	SEGMENT_CHAR('D', SEG_B | SEG_C | SEG_D | SEG_E | SEG_G),
+	SEGMENT_CHAR('E', SEG_A | SEG_D | SEG_E | SEG_F | SEG_G),
+	SEGMENT_CHAR('F', SEG_A | SEG_E | SEG_F | SEG_G),
+	SEGMENT_CHAR('H', SEG_B | SEG_C | SEG_E | SEG_F | SEG_G),
+	SEGMENT_CHAR('J', SEG_B | SEG_C | SEG_D | SEG_E),
+	SEGMENT_CHAR('L', SEG_D | SEG_E | SEG_F),
+	SEGMENT_CHAR('N', SEG_C | SEG_E | SEG_G),
+	SEGMENT_CHAR('O', SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F),
+	SEGMENT_CHAR('P', SEG_A | SEG_B | SEG_E | SEG_F | SEG_G),
+	SEGMENT_CHAR('R', SEG_E | SEG_G),
+	SEGMENT_CHAR('S', SEG_A | SEG_F | SEG_G | SEG_C | SEG_D),
+	SEGMENT_CHAR('T', SEG_D | SEG_E | SEG_F | SEG_G),
+	SEGMENT_CHAR('U', SEG_B | SEG_C | SEG_D | SEG_E | SEG_F),
+	SEGMENT_CHAR('Y', SEG_B | SEG_C | SEG_D | SEG_F | SEG_G),
+	CHAR('M'), UP(0,4), DOWN(0,0), DOWN(1,2), DOWN(2,0), DOWN(2,4),
+};
+
+#undef CHAR
+#undef SEGMENT_CHAR
+#undef UP
+#undef DOWN
+
+#define OUTLINE_SIZE	((int)(sizeof(outline) / sizeof(outline[0])))
+
+//The segments join the six vertices col + 2*row, (2*col,2*row) in the cell.
+#define NUM_SEGMENTS	7
+#define NUM_SEGMENT_VERTICES	6
+#define MAX_TRACE	16	//every segment, a move to start each of at most 4 strokes, and the settle
+
+static constexpr int segment_ends[NUM_SEGMENTS][2] = {
+	{ 0, 1 }, { 1, 3 }, { 3, 5 }, { 4, 5 }, { 2, 4 }, { 0, 2 }, { 2, 3 },
+};
+
+static constexpr int VertexX(int v) { return 2 * (v % 2); }
+static constexpr int VertexY(int v) { return 2 * (v / 2); }
+
+//A traversal of a character's segments, the vertices reached in order.
+typedef struct
+{
+	int vertex[MAX_TRACE];
+	bool down[MAX_TRACE];
+	int length;
+	int ups;	//blank moves after the first
+	int travel;	//their length along the longer axis, as the galvos take it
+	int emitted;	//vertices left once straight runs are joined
+} SegmentTrace;
+
+//True if the pen goes straight on through the middle of the three vertices.
+static constexpr bool Straight(int a, int b, int c)
+{
+	return VertexX(b) - VertexX(a) == VertexX(c) - VertexX(b) && VertexY(b) - VertexY(a) == VertexY(c) - VertexY(b);
+}
+
+//True if vertex i of the trace is drawn through in a straight line and need not be a vertex
+//of its own; one would only add a corner dwell halfway along the line.
+static constexpr bool Joined(const SegmentTrace& trace, int i)
+{
+	return i > 0 && i + 1 < trace.length && trace.down[i] && trace.down[i + 1] &&
+			Straight(trace.vertex[i - 1], trace.vertex[i], trace.vertex[i + 1]);
+}
+
+static constexpr int Emitted(const SegmentTrace& trace)
+{
+	int count = 0;
+	for (int i = 0; i < trace.length; i++)
+		count += Joined(trace, i) ? 0 : 1;
+	return count;
+}
+
+//Fewest blank moves first, then the shortest blanked travel, then the fewest corners.
+static constexpr bool Better(const SegmentTrace& a, const SegmentTrace& b)
+{
+	if (a.ups != b.ups)
+		return a.ups < b.ups;
+	if (a.travel != b.travel)
+		return a.travel < b.travel;
+	return a.emitted < b.emitted;
+}
+
+static constexpr bool Touches(int segments, int v)
+{
+	for (int s = 0; s < NUM_SEGMENTS; s++) {
+		if ((segments & (1 << s)) && (segment_ends[s][0] == v || segment_ends[s][1] == v))
+			return true;
+	}
+	return false;
+}
+
+//Tries every way on from vertex at through the segments left, keeping the best in best.  The
+//pen is only lifted once it is stuck, so a character whose segments form an Eulerian path is
+//drawn in one stroke, and any other in one stroke per pair of vertices with an odd number of
+//segments.
+static constexpr void TraceFrom(int segments, int at, SegmentTrace& path, SegmentTrace& best)
+{
+	if (segments == 0) {
+		path.emitted = Emitted(path);
+		if (Better(path, best))
+			best = path;
+		return;
+	}
+	if (path.ups > best.ups || (path.ups == best.ups && path.travel > best.travel))
+		return;
+
+	bool moved = false;
+	for (int s = 0; s < NUM_SEGMENTS && at >= 0; s++) {
+		if (!(segments & (1 << s)) || (segment_ends[s][0] != at && segment_ends[s][1] != at))
+			continue;
+		path.vertex[path.length] = (segment_ends[s][0] == at) ? segment_ends[s][1] : segment_ends[s][0];
+		path.down[path.length] = true;
+		path.length++;
+		TraceFrom(segments & ~(1 << s), path.vertex[path.length - 1], path, best);
+		path.length--;
+		moved = true;
+	}
+	if (moved)
+		return;
+
+	for (int v = 0; v < NUM_SEGMENT_VERTICES; v++) {
+		if (!Touches(segments, v))
+			continue;
+		int dx = (at >= 0) ? VertexX(v) - VertexX(at) : 0;
+		int dy = (at >= 0) ? VertexY(v) - VertexY(at) : 0;
+		int travel = (dx < 0 ? -dx : dx) > (dy < 0 ? -dy : dy) ? (dx < 0 ? -dx : dx) : (dy < 0 ? -dy : dy);
+		path.vertex[path.length] = v;
+		path.down[path.length] = false;
+		path.length++;
+		path.ups += (at >= 0) ? 1 : 0;
+		path.travel += travel;
+		TraceFrom(segments, v, path, best);
+		path.travel -= travel;
+		path.ups -= (at >= 0) ? 1 : 0;
+		path.length--;
+	}
+}
+
+//Writes the vertices that draw the segments to out, if not NULL.  Returns how many there are.
+static constexpr int TraceSegments(int segments, FontVertex* out)
+{
+	SegmentTrace path = {};
+	SegmentTrace best = {};
+	best.ups = NUM_SEGMENTS + 1;
+	TraceFrom(segments & ~SEG_SETTLE, -1, path, best);
+
+	int count = 0;
+	for (int i = 0; i < best.length; i++) {
+		int repeat = (i == 0 && (segments & SEG_SETTLE)) ? 2 : 1;
+		for (int r = 0; r < repeat && !Joined(best, i); r++) {
+			if (out)
+				out[count] = { (unsigned char)VertexX(best.vertex[i]), (unsigned char)VertexY(best.vertex[i]),
+						(unsigned char)(best.down[i] ? PEN_DOWN : PEN_UP) };
+			count++;
+		}
+	}
+	return count;
+}
+
+static constexpr int FontSize()
+{
+	int size = 0;
+	for (int i = 0; i < OUTLINE_SIZE; i++)
+		size += (outline[i].pen == SEGMENTS) ? 1 + TraceSegments(outline[i].y, nullptr) : 1;
+	return size;
+}
+
+static constexpr int font_size = FontSize();
+#define FONT_SIZE	font_size
+
+typedef struct
+{
+	FontVertex vertices[FONT_SIZE];
+} Font;
+
+//The outline with every segment character traced into its vertices.
+static constexpr Font TraceFont()
+{
+	Font traced = {};
+	int n = 0;
+
+	for (int i = 0; i < OUTLINE_SIZE; i++) {
+		if (outline[i].pen != SEGMENTS) {
+			traced.vertices[n++] = outline[i];
+			continue;
+		}
+		traced.vertices[n++] = { outline[i].x, 0, GLYPH };
+		n += TraceSegments(outline[i].y, &traced.vertices[n]);
+	}
+	return traced;
+}
+
+static constexpr Font traced_font = TraceFont();
+static constexpr const FontVertex* font = traced_font.vertices;
+
+#define FONT_CHARS	128
+
+typedef struct
+{
+	short first[FONT_CHARS];	//index of the first vertex, 0 if the font has no such character
+	short count[FONT_CHARS];
+} FontIndex;
+
+static constexpr FontIndex IndexFont()
+{
+	FontIndex index = {};
+
+	for (int i = 0; i < FONT_SIZE; i++) {
+		if (font[i].pen != GLYPH)
+			continue;
+		int c = font[i].x;
+		int n = 0;
+		while (i + 1 + n < FONT_SIZE && font[i + 1 + n].pen != GLYPH)
+			n++;
+		index.first[c] = i + 1;
+		index.count[c] = n;
+	}
+	return index;
+}
+
+static constexpr FontIndex font_index = IndexFont();
+
+//Vertex offsets from the cell origin for one size.
+typedef struct
+{
+	int size;
+	short x[FONT_SIZE];
+	short y[FONT_SIZE];
+} ScaledFont;
+
+//Scales as the hand-coded digits did: whole sizes are exact, half sizes truncate.
+static constexpr int Scale(int v, int size)
+{
+	return v * size / 2;
+}
+
+static constexpr ScaledFont ScaleFont(int size)
+{
+	ScaledFont scaled = {};
+
+	scaled.size = size;
+	for (int i = 0; i < FONT_SIZE; i++) {
+		scaled.x[i] = Scale(font[i].x, size);
+		scaled.y[i] = -Scale(font[i].y, size);
+	}
+	return scaled;
+}
+
+//The sizes the clock is usually run at.
+static constexpr ScaledFont prescaled[] = {
+	ScaleFont(100), ScaleFont(150), ScaleFont(200), ScaleFont(250), ScaleFont(300), ScaleFont(350),
+};
+
+//Blank moves in character c, the one to its start included.
+static constexpr int PenUps(char c)
+{
+	int ups = 0;
+	for (int i = font_index.first[(int)c]; i < font_index.first[(int)c] + font_index.count[(int)c]; i++)
+		ups += (font[i].pen == PEN_UP) ? 1 : 0;
+	return ups;
+}
+
+static_assert(PenUps('8') == 1 && PenUps('3') == 2, "segment characters are traced at compile time, in the fewest strokes");
+static_assert(prescaled[3].x[font_index.first['0'] + 1] == 250 && prescaled[3].y[font_index.first['0'] + 2] == -500,
+		"digit cell is one size wide and two tall");
+
+static const ScaledFont* Prescaled(int size)
+{
+	for (unsigned i = 0; i < sizeof(prescaled) / sizeof(prescaled[0]); i++) {
+		if (prescaled[i].size == size)
+			return &prescaled[i];
+	}
+	return NULL;
+}
+
+bool FontHasChar(char c)
+{
+	return (unsigned char)c < FONT_CHARS && font_index.count[(int)c] > 0;
+}
+
+int DrawChar(Frame* frame, char c, int x, int y, int color, int size)
+{
+	if (!FontHasChar(c))
+		return frame->num_points - 1;
+
+	int first = font_index.first[(int)c];
+	int last = first + font_index.count[(int)c];
+	const ScaledFont* scaled = Prescaled(size);
+
+	for (int i = first; i < last; i++) {
+		int dx = scaled ? scaled->x[i] : Scale(font[i].x, size);
+		int dy = scaled ? scaled->y[i] : -Scale(font[i].y, size);
+		DrawLineTo(frame, x + dx, y + dy, font[i].pen == PEN_DOWN ? color : 0);
+	}
+	return frame->num_points - 1;
+}
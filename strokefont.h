@@ -0,0 +1,19 @@
+//Stroke font.  Characters are data rather than code: each is a run of vertices on a cell one
+//size wide and two sizes tall, reached in order with the beam either blanked or visible, the
+//same DrawLineTo sequences the hand-coded digits used to make.  The digits, '-' and the letters
+//a 7-segment display can show are given as the segments that are lit instead, and traced into
+//the order with the fewest blank moves, an Eulerian path through the segments where there is
+//one, then the shortest blanked travel and the fewest corners; an 8 takes a single stroke.
+//The traced vertex table, the character index and the vertex offsets for the common sizes are
+//all built at compile time; other sizes are scaled as they are drawn.
+
+#include "main.h"
+
+#pragma once
+
+//Draws character c in the cell from (x,y) to (x+size,y-2*size), as DrawDigit places a digit.
+//Returns the index of the last point written.  Characters the font does not have draw nothing.
+int DrawChar(Frame* frame, char c, int x, int y, int color, int size);
+
+//Returns true if the font has character c.
+bool FontHasChar(char c);
@@ -0,0 +1,230 @@
+//Frames in the Helios USB wire format, see wireframe.h
+
+#include "wireframe.h"
+#include <string.h>
+
+void BeginWireFrame(WireFrame* wire)
+{
+	wire->num_points = 0;
+	wire->size = 0;
+	wire->part = 0;
+}
+
+void EncodeWirePoints(uint8_t* out, const HeliosDacClass::HeliosPoint* points, int count, int dx, int dy, int brightness)
+{
+	for (int i = 0; i < count; i++) {
+		int x = points[i].x + dx;
+		int y = points[i].y + dy;
+
+		x = (x < 0) ? 0 : (x > 4095) ? 4095 : x;
+		y = (y < 0) ? 0 : (y > 4095) ? 4095 : y;
+
+		out[0] = x >> 4;
+		out[1] = ((x & 0x0F) << 4) | (y >> 8);
+		out[2] = y & 0xFF;
+		out[3] = (points[i].r * brightness) / FULL_BRIGHTNESS;
+		out[4] = (points[i].g * brightness) / FULL_BRIGHTNESS;
+		out[5] = (points[i].b * brightness) / FULL_BRIGHTNESS;
+		out[6] = (points[i].i * brightness) / FULL_BRIGHTNESS;
+		out += WIRE_POINT_SIZE;
+	}
+}
+
+int PackWirePoints(WireFrame* wire, const HeliosDacClass::HeliosPoint* points, int count, int dx, int dy, int brightness)
+{
+	if (count > HELIOS_MAX_POINTS - wire->num_points)
+		count = HELIOS_MAX_POINTS - wire->num_points;
+
+	EncodeWirePoints(&wire->bytes[wire->num_points * WIRE_POINT_SIZE], points, count, dx, dy, brightness);
+
+	wire->num_points += count;
+	wire->size = 0;
+	return count;
+}
+
+//Fills count copies of the size bytes at out, the first of which are there already, doubling
+//the copied block each time.
+static void RepeatBytes(uint8_t* out, int size, int count)
+{
+	int done = size;
+	int total = size * count;
+
+	while (done < total) {
+		int n = (done < total - done) ? done : total - done;
+		memcpy(out + done, out, n);
+		done += n;
+	}
+}
+
+//Packs count copies of the point, which the caller has made room for.
+static void PackRun(WireFrame* wire, const HeliosDacClass::HeliosPoint* point, int count, int dx, int dy, int brightness)
+{
+	uint8_t* out = &wire->bytes[wire->num_points * WIRE_POINT_SIZE];
+	EncodeWirePoints(out, point, 1, dx, dy, brightness);
+	RepeatBytes(out, WIRE_POINT_SIZE, count);
+	wire->num_points += count;
+}
+
+int PackWireRuns(WireFrame* wire, const PointRun* runs, int num_runs, int dx, int dy, int brightness)
+{
+	int packed = 0;
+
+	for (int i = 0; i < num_runs && wire->num_points < HELIOS_MAX_POINTS; i++) {
+		int count = runs[i].count;
+		if (count > HELIOS_MAX_POINTS - wire->num_points)
+			count = HELIOS_MAX_POINTS - wire->num_points;
+		if (count <= 0)
+			continue;
+
+		PackRun(wire, &runs[i].point, count, dx, dy, brightness);
+		packed += count;
+	}
+
+	wire->size = 0;
+	return packed;
+}
+
+static bool Blank(const HeliosDacClass::HeliosPoint* point)
+{
+	return point->r == 0 && point->g == 0 && point->b == 0;
+}
+
+//Returns the cut from lo to hi with the most blanked points beside it, nearest target, and in
+//dark how many of the points on either side of it are blanked, 0 if none and the cut is target.
+//The runs from runs[run] on are searched, pos being offset points into it.
+static int DarkCut(const PointRun* runs, int num_runs, int run, int offset, int pos, int lo, int hi, int target, int* dark)
+{
+	int best = (target < lo) ? lo : (target > hi) ? hi : target;
+	int start = pos - offset;
+
+	*dark = 0;
+	for (int r = run; r < num_runs && start < hi; start += runs[r].count, r++) {
+		if (!Blank(&runs[r].point))
+			continue;
+
+		// A cut after point c - 1 of this run has it blanked before; the point after is blanked
+		// too up to the run's last point, or up to its end if the next run is blanked as well.
+		int end = start + runs[r].count;
+		bool next_blank = r + 1 < num_runs && Blank(&runs[r + 1].point);
+		for (int sides = 2; sides >= 1; sides--) {
+			int first = start + 1;
+			int last = (sides == 2 && !next_blank) ? end - 1 : end;
+			if (first < lo)
+				first = lo;
+			if (last > hi)
+				last = hi;
+			if (first > last || sides < *dark)
+				continue;
+
+			int c = (target < first) ? first : (target > last) ? last : target;
+			int distance = (c > target) ? c - target : target - c;
+			int best_distance = (best > target) ? best - target : target - best;
+			if (sides > *dark || distance < best_distance) {
+				best = c;
+				*dark = sides;
+			}
+		}
+	}
+	return best;
+}
+
+//Returns the earliest cut after pos, up to hi, that leaves the rest of the remaining points to
+//fit in chunks - 1 more chunks.
+static int LowestCut(int pos, int remaining, int chunks, int hi)
+{
+	int lo = pos + remaining - (chunks - 1) * HELIOS_MAX_POINTS;
+
+	if (lo < pos + 1)
+		lo = pos + 1;
+	return (lo < hi) ? lo : hi;
+}
+
+//Returns the point to end the chunk starting at point pos before, pos being offset points into
+//runs[run], with remaining points left to pack into at most left chunks.
+static int ChunkEnd(const PointRun* runs, int num_runs, int run, int offset, int pos, int remaining, int left)
+{
+	if (remaining <= HELIOS_MAX_POINTS || left <= 1)
+		return pos + ((remaining < HELIOS_MAX_POINTS) ? remaining : HELIOS_MAX_POINTS);
+
+	// Cuts up to hi that leave the rest to fit in as few chunks as hold it are tried first,
+	// nearest the even split; the chunks to spare are only used if none of them is dark.
+	int parts = (remaining + HELIOS_MAX_POINTS - 1) / HELIOS_MAX_POINTS;
+	int target = pos + (remaining + parts - 1) / parts;
+	int hi = pos + HELIOS_MAX_POINTS;
+	int dark;
+
+	int cut = DarkCut(runs, num_runs, run, offset, pos, LowestCut(pos, remaining, parts, hi), hi, target, &dark);
+	if (dark == 0 && left > parts) {
+		int spare = DarkCut(runs, num_runs, run, offset, pos, LowestCut(pos, remaining, left, hi), hi, target, &dark);
+		if (dark > 0)
+			cut = spare;
+	}
+	return cut;
+}
+
+int PackWireChunks(WireFrame* chunks, int max_chunks, const PointRun* runs, int num_runs, int dx, int dy, int brightness, int* packed)
+{
+	int total = RunPointCount(runs, num_runs);
+	int pos = 0;
+	int run = 0;
+	int offset = 0;	//points of runs[run] already packed
+	int made = 0;
+
+	while (made < max_chunks && pos < total) {
+		int end = ChunkEnd(runs, num_runs, run, offset, pos, total - pos, max_chunks - made);
+		WireFrame* chunk = &chunks[made++];
+
+		BeginWireFrame(chunk);
+		chunk->part = made - 1;
+		while (pos < end) {
+			int count = runs[run].count - offset;
+			if (count > end - pos)
+				count = end - pos;
+			if (count > 0)
+				PackRun(chunk, &runs[run].point, count, dx, dy, brightness);
+			pos += count;
+			offset += count;
+			if (offset >= runs[run].count) {
+				run++;
+				offset = 0;
+			}
+		}
+	}
+
+	*packed = pos;
+	return made;
+}
+
+int CommitWireFrame(WireFrame* wire, int pps)
+{
+	if (pps > HELIOS_MAX_RATE || pps < HELIOS_MIN_RATE)
+		return 0;
+
+	int count = wire->num_points;
+
+	// The DAC firmware mishandles transfers of these sizes.  Like WriteFrame, drop the last
+	// point and slow the rate to match so the frame still takes as long to play.
+	if (count > 1 && ((count - 45) % 64) == 0) {
+		pps = (int)((pps * (double)(count - 1) / (double)count) + 0.5);
+		count--;
+	}
+
+	uint8_t* footer = &wire->bytes[count * WIRE_POINT_SIZE];
+	footer[0] = pps & 0xFF;
+	footer[1] = pps >> 8;
+	footer[2] = count & 0xFF;
+	footer[3] = count >> 8;
+	footer[4] = 0;
+
+	wire->size = count * WIRE_POINT_SIZE + WIRE_FOOTER_SIZE;
+	return 1;
+}
+
+int SendWireFrame(HeliosDacClass& helios, int dacNum, WireFrame* wire, uint8_t flags)
+{
+	if (!helios.inited || helios.dacController == NULL || wire->size == 0)
+		return 0;
+
+	wire->bytes[wire->size - 1] = flags;
+	return helios.dacController->SendFrame(dacNum, wire->bytes, wire->size);
+}
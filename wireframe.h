@@ -0,0 +1,57 @@
+//Frames in the Helios USB wire format.  HeliosDacClass::WriteFrame repacks the point array into
+//this format on every call; staging it once lets a frame be packed in the same pass that places
+//it for a DAC, and every repeat of it is sent as is with HeliosDac::SendFrame.
+//
+//Each point is 7 bytes: x bits 11-4, x bits 3-0 and y bits 11-8, y bits 7-0, r, g, b, i.
+//The frame ends with a 5 byte footer: pps (LSB first), number of points (LSB first), flags.
+
+#include "main.h"
+#include "pointruns.h"
+
+#pragma once
+
+#define WIRE_POINT_SIZE		7
+#define WIRE_FOOTER_SIZE	5
+
+//Frames of a MAX_POINTS frame cut to fit the DAC, with one to spare so the cuts can be moved onto blanked points.
+#define MAX_WIRE_CHUNKS		((MAX_POINTS + HELIOS_MAX_POINTS - 1) / HELIOS_MAX_POINTS + 1)
+
+typedef struct
+{
+	uint8_t bytes[HELIOS_MAX_POINTS * WIRE_POINT_SIZE + WIRE_FOOTER_SIZE];
+	int num_points;
+	int size;	//bytes to send, including the footer, 0 until committed
+	int part;	//which of the frames a frame was cut into, 0 for the first or only one
+} WireFrame;
+
+//Starts a new frame in the staging buffer.
+void BeginWireFrame(WireFrame* wire);
+
+//Writes count points at out in the wire format, shifted by (dx,dy) and clamped to the DAC range,
+//with the colors scaled by brightness out of FULL_BRIGHTNESS.
+void EncodeWirePoints(uint8_t* out, const HeliosDacClass::HeliosPoint* points, int count, int dx, int dy, int brightness);
+
+//Packs count points into the frame as EncodeWirePoints does.
+//Returns the number of points packed, fewer if the frame reached HELIOS_MAX_POINTS.
+int PackWirePoints(WireFrame* wire, const HeliosDacClass::HeliosPoint* points, int count, int dx, int dy, int brightness);
+
+//Packs the runs into the frame as PackWirePoints would their points: each run's point is
+//encoded once and its bytes copied out for the rest of the run.
+//Returns the number of points packed, fewer if the frame reached HELIOS_MAX_POINTS.
+int PackWireRuns(WireFrame* wire, const PointRun* runs, int num_runs, int dx, int dy, int brightness);
+
+//Packs runs of more points than the DAC takes in one frame into as few frames of up to
+//HELIOS_MAX_POINTS as hold them, at most max_chunks, to be played once each, back to back.  Each
+//cut is made where the beam is blanked on both sides of it if there is such a place, else just
+//after a blanked point, so the seam between two frames is dark; of those, the one that divides
+//the points most evenly is taken.  Frames are begun here but not committed.
+//Returns the number of frames, with the number of points packed in packed, fewer than the runs
+//hold if they did not fit in max_chunks frames.
+int PackWireChunks(WireFrame* chunks, int max_chunks, const PointRun* runs, int num_runs, int dx, int dy, int brightness, int* packed);
+
+//Finishes the frame with its footer, at pps points per second.  Returns 0 if pps is out of range.
+int CommitWireFrame(WireFrame* wire, int pps);
+
+//Sends a committed frame to the DAC with the given WriteFrame flags.
+//Returns 1 if successful, as WriteFrame does.
+int SendWireFrame(HeliosDacClass& helios, int dacNum, WireFrame* wire, uint8_t flags);